@@ -0,0 +1,419 @@
+/*
+
+mod_sslhaf: Apache module for passive SSL client fingerprinting
+
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * sslhaf_bench replays a corpus of ClientHellos (bench/corpus.txt)
+ * through the code the module runs for every connection, and reports,
+ * for each ClientHello and stage, the time per handshake and the
+ * number and total size of the allocations made.
+ *
+ * The stages differ in what the library is asked to compute, which
+ * is how the cost of each step can be told apart:
+ *
+ * - parse:   the records and the ClientHello, with no outputs, in one
+ *            call, as when the whole packet arrives in one bucket.
+ * - chunked: the same, fed 16 bytes at a time, which exercises the
+ *            buffering across buckets and records.
+ * - lists:   parse, plus the suites, compression, extensions and curves
+ *            strings that the module gives to requests.
+ * - ja3:     parse, plus the JA3 string and its MD5.
+ * - ja4:     parse, plus JA4.
+ * - raw:     parse, plus the copy of the packet and its hex encoding.
+ * - all:     everything, as the module does by default.
+ *
+ * Before anything is timed, every ClientHello is fingerprinted with all
+ * the outputs, whole and 16 bytes at a time, and its JA3 hash and JA4
+ * fingerprint are checked against those in the corpus; if any of them
+ * doesn't match, sslhaf_bench says which and exits with status 1, so it
+ * doubles as a known-answer test of the library. With -k, it stops
+ * there. What the module does after the library, in the filter and when
+ * a request arrives, is setting table entries that point to the results.
+ *
+ * To compile and run, from the top directory:
+ *
+ *     $ cc -O2 -I. -o sslhaf_bench bench/sslhaf_bench.c sslhaf.c
+ *     $ ./sslhaf_bench [-c bench/corpus.txt] [-k] [-s stage] [-t seconds]
+ *
+ * Each measurement runs for at least the given time (0.2 seconds by
+ * default). Compare numbers taken on the same machine only.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sslhaf.h"
+
+#define BENCH_MAX_CORPUS    256
+#define BENCH_ARENA_SIZE    (1024 * 1024)
+#define BENCH_CHUNK         16
+
+#define OUTPUT_LISTS (SSLHAF_OUTPUT_SUITES | SSLHAF_OUTPUT_COMPRESSION \
+    | SSLHAF_OUTPUT_EXTENSIONS | SSLHAF_OUTPUT_CURVES)
+
+typedef struct bench_stage_t {
+    const char *name;
+    unsigned int outputs;
+    size_t chunk;
+} bench_stage_t;
+
+static const bench_stage_t stages[] = {
+    { "parse", 0, 0 },
+    { "chunked", 0, BENCH_CHUNK },
+    { "lists", OUTPUT_LISTS, 0 },
+    { "ja3", SSLHAF_OUTPUT_JA3, 0 },
+    { "ja4", SSLHAF_OUTPUT_JA4, 0 },
+    { "raw", SSLHAF_OUTPUT_RAW, 0 },
+    { "all", SSLHAF_OUTPUT_ALL, 0 },
+    { NULL, 0, 0 }
+};
+
+typedef struct bench_hello_t {
+    char *name;
+    unsigned char *data;
+    size_t len;
+
+    /* The expected results; the JA4 is empty for SSLv2. */
+    char *ja3;
+    char *ja4;
+} bench_hello_t;
+
+/* The arena the library allocates from, reset for every handshake,
+ * and what was asked of it. */
+typedef struct bench_alloc_t {
+    sslhaf_arena_t arena;
+    unsigned long count;
+    unsigned long bytes;
+} bench_alloc_t;
+
+static bench_hello_t corpus[BENCH_MAX_CORPUS];
+static int corpus_len = 0;
+
+static void *bench_alloc(void *ctx, size_t size) {
+    bench_alloc_t *a = ctx;
+
+    a->count++;
+    a->bytes += size;
+
+    return sslhaf_arena_alloc(&a->arena, size);
+}
+
+/**
+ * Load the corpus. Returns -1 on error.
+ */
+static int load_corpus(const char *filename) {
+    static char line[(SSLHAF_HELLO_LIMIT + 1024) * 2];
+    unsigned int lineno = 0;
+    FILE *f;
+
+    f = fopen(filename, "r");
+    if (f == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *name = line, *hex, *ja3, *ja4;
+        size_t len;
+
+        lineno++;
+
+        len = strcspn(line, "\r\n");
+        line[len] = '\0';
+
+        if ((line[0] == '\0')||(line[0] == '#')) {
+            continue;
+        }
+
+        hex = strchr(line, ' ');
+        ja3 = (hex != NULL) ? strchr(hex + 1, ' ') : NULL;
+        ja4 = (ja3 != NULL) ? strchr(ja3 + 1, ' ') : NULL;
+        if ((ja4 == NULL)||(strchr(ja4 + 1, ' ') != NULL)||((ja3 - hex - 1) % 2 != 0)
+            ||(corpus_len == BENCH_MAX_CORPUS))
+        {
+            fprintf(stderr, "sslhaf_bench: %s:%u: Invalid entry\n", filename, lineno);
+            fclose(f);
+            return -1;
+        }
+
+        *hex++ = '\0';
+        *ja3++ = '\0';
+        *ja4++ = '\0';
+        len = strlen(hex) / 2;
+
+        corpus[corpus_len].name = strdup(name);
+        corpus[corpus_len].data = malloc(len);
+        corpus[corpus_len].len = len;
+        corpus[corpus_len].ja3 = strdup(ja3);
+        corpus[corpus_len].ja4 = strdup(strcmp(ja4, "-") == 0 ? "" : ja4);
+
+        if ((corpus[corpus_len].name == NULL)||(corpus[corpus_len].data == NULL)
+            ||(corpus[corpus_len].ja3 == NULL)||(corpus[corpus_len].ja4 == NULL))
+        {
+            fprintf(stderr, "sslhaf_bench: Out of memory\n");
+            fclose(f);
+            return -1;
+        }
+
+        if (sslhaf_hex_decode(hex, len, corpus[corpus_len].data) < 0) {
+            fprintf(stderr, "sslhaf_bench: %s:%u: Invalid hex digit\n", filename, lineno);
+            fclose(f);
+            return -1;
+        }
+
+        corpus_len++;
+    }
+
+    fclose(f);
+
+    if (corpus_len == 0) {
+        fprintf(stderr, "sslhaf_bench: %s: No ClientHellos\n", filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Run one handshake through the library. Returns what the last
+ * sslhaf_feed() call did.
+ */
+static int run_once(const bench_stage_t *stage, const bench_hello_t *hello,
+    bench_alloc_t *alloc, sslhaf_t *h)
+{
+    size_t off, len;
+    int rc = SSLHAF_AGAIN;
+
+    alloc->arena.used = 0;
+
+    sslhaf_init(h, stage->outputs, SSLHAF_HELLO_LIMIT, bench_alloc, alloc);
+
+    if (stage->chunk == 0) {
+        return sslhaf_feed(h, hello->data, hello->len);
+    }
+
+    for (off = 0; (off < hello->len)&&(rc == SSLHAF_AGAIN); off += len) {
+        len = hello->len - off;
+        if (len > stage->chunk) {
+            len = stage->chunk;
+        }
+
+        rc = sslhaf_feed(h, hello->data + off, len);
+    }
+
+    return rc;
+}
+
+/**
+ * Check that a ClientHello gets the JA3 hash and JA4 fingerprint the
+ * corpus says it should, fed whole and in chunks. Returns -1 if not.
+ */
+static int check(const bench_hello_t *hello) {
+    static const bench_stage_t whole = { "check", SSLHAF_OUTPUT_ALL, 0 };
+    static const bench_stage_t chunked = { "check", SSLHAF_OUTPUT_ALL, BENCH_CHUNK };
+    const bench_stage_t *stage[2] = { &whole, &chunked };
+    bench_alloc_t alloc;
+    sslhaf_t h;
+    int i, rc = 0;
+
+    alloc.arena.base = malloc(BENCH_ARENA_SIZE);
+    alloc.arena.size = BENCH_ARENA_SIZE;
+    if (alloc.arena.base == NULL) {
+        fprintf(stderr, "sslhaf_bench: Out of memory\n");
+        return -1;
+    }
+
+    for (i = 0; (i < 2)&&(rc == 0); i++) {
+        if ((run_once(stage[i], hello, &alloc, &h) != SSLHAF_DONE)||(!h.done)) {
+            fprintf(stderr, "sslhaf_bench: %s: Not fingerprinted: %s\n", hello->name,
+                h.error[0] != '\0' ? h.error : "incomplete");
+            rc = -1;
+        } else if ((strcmp(h.ja3_hash, hello->ja3) != 0)||(strcmp(h.ja4, hello->ja4) != 0)) {
+            fprintf(stderr, "sslhaf_bench: %s: Got %s %s, expected %s %s\n", hello->name,
+                h.ja3_hash, h.ja4[0] != '\0' ? h.ja4 : "-", hello->ja3,
+                hello->ja4[0] != '\0' ? hello->ja4 : "-");
+            rc = -1;
+        }
+    }
+
+    free(alloc.arena.base);
+
+    return rc;
+}
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ * Time one stage on one ClientHello and print a line. Returns -1 if
+ * the ClientHello is not fingerprinted.
+ */
+static int bench(const bench_stage_t *stage, const bench_hello_t *hello, double min_time) {
+    bench_alloc_t alloc;
+    unsigned long iterations = 1, i;
+    unsigned long count, bytes;
+    double start, elapsed;
+    sslhaf_t h;
+
+    alloc.arena.base = malloc(BENCH_ARENA_SIZE);
+    alloc.arena.size = BENCH_ARENA_SIZE;
+    if (alloc.arena.base == NULL) {
+        fprintf(stderr, "sslhaf_bench: Out of memory\n");
+        return -1;
+    }
+
+    // Check the result, and count the allocations of one handshake
+    alloc.count = alloc.bytes = 0;
+    if ((run_once(stage, hello, &alloc, &h) != SSLHAF_DONE)||(!h.done)) {
+        fprintf(stderr, "sslhaf_bench: %s: Not fingerprinted: %s\n", hello->name,
+            h.error[0] != '\0' ? h.error : "incomplete");
+        free(alloc.arena.base);
+        return -1;
+    }
+
+    count = alloc.count;
+    bytes = alloc.bytes;
+
+    // Double the number of iterations until they take long enough
+    for (;;) {
+        start = now();
+        for (i = 0; i < iterations; i++) {
+            run_once(stage, hello, &alloc, &h);
+        }
+        elapsed = now() - start;
+
+        if (elapsed >= min_time) {
+            break;
+        }
+
+        iterations *= 2;
+    }
+
+    printf("%-8s %-22s %7lu %10.0f %7lu %9lu\n", stage->name, hello->name,
+        (unsigned long)hello->len, (elapsed * 1e9) / iterations, count, bytes);
+
+    free(alloc.arena.base);
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *filename = "bench/corpus.txt";
+    const char *only = NULL;
+    double min_time = 0.2;
+    int c, i, j, found = 0, check_only = 0, failed = 0;
+
+    while ((c = getopt(argc, argv, "c:ks:t:")) != -1) {
+        switch (c) {
+            case 'c' :
+                filename = optarg;
+                break;
+
+            case 'k' :
+                check_only = 1;
+                break;
+
+            case 's' :
+                only = optarg;
+                break;
+
+            case 't' :
+                min_time = atof(optarg);
+                break;
+
+            default :
+                fprintf(stderr, "Usage: sslhaf_bench [-c corpus] [-k] [-s stage] [-t seconds]\n");
+                return 2;
+        }
+    }
+
+    if (load_corpus(filename) < 0) {
+        return 1;
+    }
+
+    // Known answers first; timing wrong results is no use
+    for (j = 0; j < corpus_len; j++) {
+        if (check(&corpus[j]) < 0) {
+            failed++;
+        }
+    }
+
+    if (failed > 0) {
+        fprintf(stderr, "sslhaf_bench: %d of %d ClientHellos failed the check\n",
+            failed, corpus_len);
+        return 1;
+    }
+
+    if (check_only) {
+        printf("%d ClientHellos checked\n", corpus_len);
+        return 0;
+    }
+
+    printf("%-8s %-22s %7s %10s %7s %9s\n", "stage", "clienthello", "bytes",
+        "ns/hello", "allocs", "alloc_b");
+
+    for (i = 0; stages[i].name != NULL; i++) {
+        if ((only != NULL)&&(strcmp(only, stages[i].name) != 0)) {
+            continue;
+        }
+
+        found = 1;
+
+        for (j = 0; j < corpus_len; j++) {
+            if (bench(&stages[i], &corpus[j], min_time) < 0) {
+                return 1;
+            }
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "sslhaf_bench: Unknown stage: %s\n", only);
+        return 2;
+    }
+
+    return 0;
+}
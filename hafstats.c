@@ -0,0 +1,1074 @@
+/*
+
+mod_sslhaf: Apache module for passive SSL client fingerprinting
+
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * hafstats produces statistics about the SSL clients in an sslhaf log,
+ * one written with a CustomLog line such as:
+ *
+ *     CustomLog logs/sslhaf.log "%t %h \"%{SSLHAF_HANDSHAKE}e\" \
+ *     \"%{SSLHAF_PROTOCOL}e\" \"%{SSLHAF_SUITES}e\" \"%{SSLHAF_COMPRESSION}e\" \
+ *     \"%{SSLHAF_BEAST}e\" \"%{SSLHAF_EXTENSIONS_LEN}e\" \"%{SSLHAF_EXTENSIONS}e\" \
+ *     \"%{SSLHAF_RAW}e\" \"%{User-Agent}i\"" env=SSLHAF_LOG
+ *
+ * (SSLHAF_RAW is optional.) Every client, identified by its IP address
+ * and User-Agent, is counted once, with the last handshake logged for
+ * it. The report has the protocol and handshake versions, how many
+ * clients support compression, BEAST mitigation, RC4 and secure
+ * renegotiation, and the cipher suites and extensions by popularity.
+ * Lines that don't look like the above are printed as invalid.
+ *
+ * By default, only the clients whose User-Agent looks like a browser
+ * (starts with "Mozilla/") are counted; -a counts all of them.
+ *
+ * The log is mapped into memory and split at line boundaries into as
+ * many chunks as there are threads (-j, by default one per CPU). Each
+ * thread keeps its own tables, which are merged at the end:
+ *
+ * - one entry per client, of fixed size: the hash of the client and of
+ *   its handshake, and where in the log the client first and last
+ *   appears, which is how the last handshake wins and how the output
+ *   comes out in the same order whatever the number of threads.
+ *
+ * - one entry per distinct handshake, pointing to a line that has it.
+ *
+ * Clients and handshakes are told apart by 64-bit hashes, so memory
+ * depends only on the number of distinct clients and handshakes, not
+ * on the size of the log.
+ *
+ * To compile:
+ *
+ *     $ cc -O2 -pthread -I. -o hafstats hafstats.c sslhaf.c
+ *
+ * Usage:
+ *
+ *     $ hafstats [-a] [-j threads] FILENAME
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sslhaf.h"
+
+#define MAX_THREADS     256
+#define HASH_INIT       0xcbf29ce484222325ULL
+
+/* A piece of a line. */
+typedef struct span_t {
+    const char *p;
+    size_t len;
+} span_t;
+
+/* The fields of a log line that the report uses. */
+typedef struct haf_line_t {
+    span_t ip;
+    span_t handshake;
+    span_t protocol;
+    span_t suites;
+    span_t compression;
+    span_t beast;
+    span_t extensions;
+    span_t ua;
+} haf_line_t;
+
+/* A client, by IP address and User-Agent, and its last handshake and
+ * whether it looks like a browser. Offsets are stored plus one. */
+typedef struct haf_client_t {
+    uint64_t key;
+    uint64_t hello;
+    uint64_t first;
+    uint64_t last;
+    int browser;
+} haf_client_t;
+
+/* A distinct handshake, and the line it was first seen on. */
+typedef struct haf_hello_t {
+    uint64_t hash;
+    haf_line_t fields;
+    int used;
+
+    /* Filled in for the report: how many clients have this as their
+     * last handshake, and when the first of them was counted. */
+    unsigned long count;
+    long order;
+} haf_hello_t;
+
+/* An open-addressing hash table of fixed-size entries, keyed by the
+ * first 64 bits of the entry. Empty entries are all zero; a key that
+ * hashes to 0 is stored as 1. */
+typedef struct haf_table_t {
+    void *entries;
+    size_t entry_size;
+    size_t size;
+    size_t used;
+} haf_table_t;
+
+/* An invalid line, to be reported. */
+typedef struct haf_invalid_t {
+    size_t offset;
+    size_t len;
+} haf_invalid_t;
+
+/* What a thread works on, and what it finds. */
+typedef struct haf_chunk_t {
+    const char *base;
+    size_t start;
+    size_t end;
+
+    haf_table_t clients;
+    haf_table_t hellos;
+
+    haf_invalid_t *invalid;
+    size_t invalid_len;
+    size_t invalid_size;
+
+    int error;
+} haf_chunk_t;
+
+/* A counter in the report, keyed by string, which keeps the order
+ * in which its keys were first seen. */
+typedef struct haf_count_t {
+    const char *key;
+    size_t key_len;
+    unsigned long value;
+    size_t seq;
+} haf_count_t;
+
+typedef struct haf_counter_t {
+    haf_count_t *items;
+    size_t len;
+    size_t size;
+} haf_counter_t;
+
+typedef struct haf_stats_t {
+    unsigned long total;
+    unsigned long beast_mitigated;
+    haf_counter_t protocols;
+    unsigned long compression_support;
+    unsigned long secure_renegotiation;
+    haf_counter_t handshake;
+    haf_counter_t suites;
+    haf_counter_t extensions;
+    unsigned long rc4;
+    int rc4_seen;
+} haf_stats_t;
+
+static int browsers_only = 1;
+
+/**
+ * FNV-1a, continued from h.
+ */
+static uint64_t hash_bytes(uint64_t h, const char *p, size_t len) {
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        h = (h ^ (unsigned char)p[i]) * 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+/**
+ * Mix the hash so that the low bits, which pick the slot, depend on all
+ * of the input; never returns 0, which marks empty slots.
+ */
+static uint64_t hash_final(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+
+    return (h != 0) ? h : 1;
+}
+
+static void *xmalloc(size_t size) {
+    void *p = malloc(size);
+
+    if (p == NULL) {
+        fprintf(stderr, "hafstats: Out of memory\n");
+        exit(1);
+    }
+
+    return p;
+}
+
+static void table_init(haf_table_t *t, size_t entry_size) {
+    t->entry_size = entry_size;
+    t->size = 1024;
+    t->used = 0;
+    t->entries = calloc(t->size, entry_size);
+
+    if (t->entries == NULL) {
+        fprintf(stderr, "hafstats: Out of memory\n");
+        exit(1);
+    }
+}
+
+/**
+ * Find the entry for key, or the empty slot where it would go.
+ */
+static void *table_slot(const haf_table_t *t, uint64_t key) {
+    size_t i = key & (t->size - 1);
+
+    for (;;) {
+        char *e = (char *)t->entries + (i * t->entry_size);
+        uint64_t k;
+
+        memcpy(&k, e, sizeof(k));
+        if ((k == key)||(k == 0)) {
+            return e;
+        }
+
+        i = (i + 1) & (t->size - 1);
+    }
+}
+
+/**
+ * Find the entry for key, creating it if there is none; a new entry is
+ * all zero but for the key. Sets *created accordingly.
+ */
+static void *table_get(haf_table_t *t, uint64_t key, int *created) {
+    char *e;
+    uint64_t k;
+
+    // Keep the load under a half
+    if ((t->used + 1) * 2 > t->size) {
+        haf_table_t n = *t;
+        size_t i;
+
+        n.size = t->size * 2;
+        n.entries = calloc(n.size, t->entry_size);
+        if (n.entries == NULL) {
+            fprintf(stderr, "hafstats: Out of memory\n");
+            exit(1);
+        }
+
+        for (i = 0; i < t->size; i++) {
+            char *old = (char *)t->entries + (i * t->entry_size);
+
+            memcpy(&k, old, sizeof(k));
+            if (k != 0) {
+                memcpy(table_slot(&n, k), old, t->entry_size);
+            }
+        }
+
+        free(t->entries);
+        *t = n;
+    }
+
+    e = table_slot(t, key);
+    memcpy(&k, e, sizeof(k));
+
+    *created = (k == 0);
+    if (k == 0) {
+        memcpy(e, &key, sizeof(key));
+        t->used++;
+    }
+
+    return e;
+}
+
+/* Character classes of the log line pattern. */
+static int is_digit(int c) { return (c >= '0')&&(c <= '9'); }
+static int is_alnum(int c) { return is_digit(c)||((c >= 'a')&&(c <= 'z'))||((c >= 'A')&&(c <= 'Z')); }
+static int is_version(int c) { return is_digit(c)||(c == '.'); }
+static int is_word_list(int c) { return is_alnum(c)||(c == '_')||(c == ','); }
+static int is_number_list(int c) { return is_digit(c)||(c == '-')||(c == ','); }
+static int is_bit(int c) { return (c == '0')||(c == '1'); }
+static int is_id_list(int c) { return is_alnum(c)||(c == '-')||(c == ','); }
+static int is_id(int c) { return is_alnum(c)||(c == '-'); }
+
+static int is_space(int c) {
+    return (c == ' ')||(c == '\t')||(c == '\n')||(c == '\v')||(c == '\f')||(c == '\r');
+}
+
+/**
+ * Match, at *pos, a quoted field of one or more characters of the
+ * given class, preceded by a space unless it's the first. Returns
+ * -1 if there's no match.
+ */
+static int match_field(const char *line, size_t len, size_t *pos, int (*cls)(int), span_t *out) {
+    size_t i = *pos;
+
+    if ((i + 2 > len)||(line[i] != ' ')||(line[i + 1] != '"')) {
+        return -1;
+    }
+
+    i += 2;
+    out->p = line + i;
+
+    while ((i < len)&&(cls((unsigned char)line[i]))) {
+        i++;
+    }
+
+    out->len = (line + i) - out->p;
+    if ((out->len == 0)||(i >= len)||(line[i] != '"')) {
+        return -1;
+    }
+
+    *pos = i + 1;
+
+    return 0;
+}
+
+/**
+ * Split a log line (without the newline) into its fields. Returns -1
+ * if the line doesn't match the format:
+ *
+ *   [time] ip "handshake" "protocol" "suites" "compression" "beast"
+ *   "extension count" "extensions" ["raw"] "user agent"
+ */
+static int parse_line(const char *line, size_t len, haf_line_t *f) {
+    span_t count, raw;
+    size_t i = 0, rest;
+
+    // The time, up to the first ]
+    while ((i < len)&&(line[i] != ']')) {
+        i++;
+    }
+
+    if ((i == 0)||(i >= len)) {
+        return -1;
+    }
+
+    i++;
+
+    if ((i >= len)||(line[i] != ' ')) {
+        return -1;
+    }
+
+    i++;
+
+    f->ip.p = line + i;
+    while ((i < len)&&(!is_space((unsigned char)line[i]))) {
+        i++;
+    }
+
+    f->ip.len = (line + i) - f->ip.p;
+    if (f->ip.len == 0) {
+        return -1;
+    }
+
+    if ((match_field(line, len, &i, is_digit, &f->handshake) < 0)
+        ||(match_field(line, len, &i, is_version, &f->protocol) < 0)
+        ||(match_field(line, len, &i, is_word_list, &f->suites) < 0)
+        ||(match_field(line, len, &i, is_number_list, &f->compression) < 0)
+        ||(match_field(line, len, &i, is_bit, &f->beast) < 0)
+        ||(match_field(line, len, &i, is_digit, &count) < 0)
+        ||(match_field(line, len, &i, is_id_list, &f->extensions) < 0))
+    {
+        return -1;
+    }
+
+    // The beast field is a single character
+    if (f->beast.len != 1) {
+        return -1;
+    }
+
+    // Either the raw ClientHello and then the User-Agent, or the
+    // User-Agent alone; the User-Agent takes the rest of the line
+    rest = i;
+    if ((match_field(line, len, &i, is_id, &raw) == 0)
+        &&(i + 3 <= len)&&(line[i] == ' ')&&(line[i + 1] == '"')&&(line[len - 1] == '"'))
+    {
+        f->ua.p = line + i + 2;
+        f->ua.len = len - i - 3;
+        return 0;
+    }
+
+    i = rest;
+    if ((i + 3 <= len)&&(line[i] == ' ')&&(line[i + 1] == '"')&&(line[len - 1] == '"')) {
+        f->ua.p = line + i + 2;
+        f->ua.len = len - i - 3;
+        return 0;
+    }
+
+    return -1;
+}
+
+/**
+ * Is the line empty, once whitespace is trimmed, or "0"?
+ */
+static int is_blank(const char *line, size_t len) {
+    size_t i, n = 0;
+    char c = 0;
+
+    for (i = 0; i < len; i++) {
+        if ((line[i] != ' ')&&(line[i] != '\t')&&(line[i] != '\n')&&(line[i] != '\r')
+            &&(line[i] != '\0')&&(line[i] != '\v'))
+        {
+            c = line[i];
+            n++;
+
+            // Only the first non-blank is of interest, and only if it
+            // turns out to be the only one; stop at the second
+            if (n > 1) {
+                return 0;
+            }
+        }
+    }
+
+    return (n == 0)||(c == '0');
+}
+
+static void add_invalid(haf_chunk_t *c, size_t offset, size_t len) {
+    if (c->invalid_len == c->invalid_size) {
+        haf_invalid_t *n;
+
+        c->invalid_size = c->invalid_size ? c->invalid_size * 2 : 64;
+        n = realloc(c->invalid, c->invalid_size * sizeof(haf_invalid_t));
+        if (n == NULL) {
+            fprintf(stderr, "hafstats: Out of memory\n");
+            exit(1);
+        }
+
+        c->invalid = n;
+    }
+
+    c->invalid[c->invalid_len].offset = offset;
+    c->invalid[c->invalid_len].len = len;
+    c->invalid_len++;
+}
+
+/**
+ * Process the lines of one chunk.
+ */
+static void *process_chunk(void *arg) {
+    haf_chunk_t *c = arg;
+    size_t pos = c->start;
+
+    table_init(&c->clients, sizeof(haf_client_t));
+    table_init(&c->hellos, sizeof(haf_hello_t));
+
+    while (pos < c->end) {
+        const char *line = c->base + pos;
+        const char *nl = memchr(line, '\n', c->end - pos);
+        size_t len = (nl != NULL) ? (size_t)(nl - line) : c->end - pos;
+        size_t full = (nl != NULL) ? len + 1 : len;
+        haf_line_t f;
+        haf_client_t *client;
+        haf_hello_t *hello;
+        uint64_t key, hash;
+        int created;
+
+        if (is_blank(line, full)) {
+            pos += full;
+            continue;
+        }
+
+        if (parse_line(line, len, &f) < 0) {
+            add_invalid(c, pos, full);
+            pos += full;
+            continue;
+        }
+
+        key = hash_bytes(HASH_INIT, f.ip.p, f.ip.len);
+        key = hash_final(hash_bytes(hash_bytes(key, "_", 1), f.ua.p, f.ua.len));
+
+        // The handshake is everything the report looks at
+        hash = hash_bytes(HASH_INIT, f.handshake.p, f.handshake.len);
+        hash = hash_bytes(hash_bytes(hash, "\n", 1), f.protocol.p, f.protocol.len);
+        hash = hash_bytes(hash_bytes(hash, "\n", 1), f.suites.p, f.suites.len);
+        hash = hash_bytes(hash_bytes(hash, "\n", 1), f.compression.p, f.compression.len);
+        hash = hash_bytes(hash_bytes(hash, "\n", 1), f.beast.p, f.beast.len);
+        hash = hash_final(hash_bytes(hash_bytes(hash, "\n", 1), f.extensions.p, f.extensions.len));
+
+        hello = table_get(&c->hellos, hash, &created);
+        if (created) {
+            hello->fields = f;
+        }
+
+        client = table_get(&c->clients, key, &created);
+        if (created) {
+            client->first = pos + 1;
+        }
+
+        client->last = pos + 1;
+        client->hello = hash;
+        client->browser = (f.ua.len >= 8)&&(memcmp(f.ua.p, "Mozilla/", 8) == 0);
+
+        pos += full;
+    }
+
+    return NULL;
+}
+
+/**
+ * Merge the tables of chunk src into those of dst. Chunks are merged
+ * in order, so src comes later in the log.
+ */
+static void merge_chunk(haf_chunk_t *dst, haf_chunk_t *src) {
+    haf_client_t *clients = src->clients.entries;
+    haf_hello_t *hellos = src->hellos.entries;
+    size_t i;
+    int created;
+
+    for (i = 0; i < src->hellos.size; i++) {
+        if (hellos[i].hash != 0) {
+            haf_hello_t *h = table_get(&dst->hellos, hellos[i].hash, &created);
+            if (created) {
+                *h = hellos[i];
+            }
+        }
+    }
+
+    for (i = 0; i < src->clients.size; i++) {
+        if (clients[i].key != 0) {
+            haf_client_t *c = table_get(&dst->clients, clients[i].key, &created);
+            if (created) {
+                *c = clients[i];
+            } else {
+                c->last = clients[i].last;
+                c->hello = clients[i].hello;
+                c->browser = clients[i].browser;
+            }
+        }
+    }
+
+    free(src->clients.entries);
+    free(src->hellos.entries);
+}
+
+/**
+ * Add value to the count for key.
+ */
+static void counter_add(haf_counter_t *c, const char *key, size_t key_len, unsigned long value) {
+    size_t i;
+
+    // There are few distinct keys in a report
+    for (i = 0; i < c->len; i++) {
+        if ((c->items[i].key_len == key_len)&&(memcmp(c->items[i].key, key, key_len) == 0)) {
+            c->items[i].value += value;
+            return;
+        }
+    }
+
+    if (c->len == c->size) {
+        haf_count_t *n;
+
+        c->size = c->size ? c->size * 2 : 32;
+        n = realloc(c->items, c->size * sizeof(haf_count_t));
+        if (n == NULL) {
+            fprintf(stderr, "hafstats: Out of memory\n");
+            exit(1);
+        }
+
+        c->items = n;
+    }
+
+    c->items[c->len].key = key;
+    c->items[c->len].key_len = key_len;
+    c->items[c->len].value = value;
+    c->items[c->len].seq = c->len;
+    c->len++;
+}
+
+/**
+ * Is the string a number, and which? Only plain decimal numbers, with
+ * an optional exponent, can occur in the fields this is used on.
+ */
+static int numeric_value(const char *p, size_t len, double *value) {
+    char buf[64];
+    size_t i = 0, digits = 0;
+
+    if ((len == 0)||(len >= sizeof(buf))) {
+        return 0;
+    }
+
+    while ((i < len)&&(is_digit((unsigned char)p[i]))) i++, digits++;
+
+    if ((i < len)&&(p[i] == '.')) {
+        i++;
+        while ((i < len)&&(is_digit((unsigned char)p[i]))) i++, digits++;
+    }
+
+    if (digits == 0) {
+        return 0;
+    }
+
+    if ((i < len)&&((p[i] == 'e')||(p[i] == 'E'))) {
+        size_t e = ++i;
+
+        if ((i < len)&&((p[i] == '+')||(p[i] == '-'))) i++;
+        while ((i < len)&&(is_digit((unsigned char)p[i]))) i++;
+        if (i == e) return 0;
+    }
+
+    if (i != len) {
+        return 0;
+    }
+
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    *value = strtod(buf, NULL);
+
+    return 1;
+}
+
+/**
+ * Order keys numerically when both are numbers, otherwise as strings.
+ */
+static int compare_keys(const void *a, const void *b) {
+    const haf_count_t *x = a, *y = b;
+    double dx, dy;
+    size_t n;
+    int rc;
+
+    if (numeric_value(x->key, x->key_len, &dx)&&numeric_value(y->key, y->key_len, &dy)) {
+        if (dx != dy) {
+            return (dx < dy) ? -1 : 1;
+        }
+    } else {
+        n = (x->key_len < y->key_len) ? x->key_len : y->key_len;
+        rc = memcmp(x->key, y->key, n);
+        if (rc != 0) {
+            return rc;
+        }
+
+        if (x->key_len != y->key_len) {
+            return (x->key_len < y->key_len) ? -1 : 1;
+        }
+    }
+
+    // Keep equal keys in the order they were seen
+    return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+/**
+ * Order by value, largest first.
+ */
+static int compare_values(const void *a, const void *b) {
+    const haf_count_t *x = a, *y = b;
+
+    if (x->value != y->value) {
+        return (x->value > y->value) ? -1 : 1;
+    }
+
+    return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+/**
+ * Sort a counter, keeping the order of equal items (qsort isn't stable,
+ * so ties are broken by the order in which the keys were added).
+ */
+static void counter_sort(haf_counter_t *c, int (*cmp)(const void *, const void *)) {
+    if (c->len > 1) {
+        qsort(c->items, c->len, sizeof(haf_count_t), cmp);
+    }
+}
+
+static int compare_first(const void *a, const void *b) {
+    const haf_client_t *x = *(const haf_client_t * const *)a;
+    const haf_client_t *y = *(const haf_client_t * const *)b;
+
+    return (x->first < y->first) ? -1 : (x->first > y->first);
+}
+
+/**
+ * Does the comma-separated list have this item?
+ */
+static int list_has(span_t list, const char *item, int strip_zero) {
+    size_t len = strlen(item);
+    const char *p = list.p, *end = list.p + list.len;
+
+    for (;;) {
+        const char *comma = memchr(p, ',', end - p);
+        const char *e = (comma != NULL) ? comma : end;
+        const char *s = p;
+
+        if ((strip_zero)&&(s < e)&&(*s == '0')) {
+            s++;
+        }
+
+        if (((size_t)(e - s) == len)&&(memcmp(s, item, len) == 0)) {
+            return 1;
+        }
+
+        if (comma == NULL) {
+            return 0;
+        }
+
+        p = comma + 1;
+    }
+}
+
+/**
+ * Count the handshake of weight clients.
+ */
+static void add_hello(haf_stats_t *st, const haf_hello_t *h, unsigned long weight) {
+    const haf_line_t *f = &h->fields;
+    const char *p, *end, *comma;
+    int rc4 = 0;
+
+    // Extensions
+    if ((f->extensions.len != 1)||(f->extensions.p[0] != '-')) {
+        p = f->extensions.p;
+        end = p + f->extensions.len;
+
+        for (;;) {
+            comma = memchr(p, ',', end - p);
+            counter_add(&st->extensions, p, ((comma != NULL) ? comma : end) - p, weight);
+            if (comma == NULL) break;
+            p = comma + 1;
+        }
+    }
+
+    counter_add(&st->handshake, f->handshake.p, f->handshake.len, weight);
+    counter_add(&st->protocols, f->protocol.p, f->protocol.len, weight);
+
+    // Suites, with one leading zero removed
+    p = f->suites.p;
+    end = p + f->suites.len;
+
+    for (;;) {
+        const char *s = p;
+        double value;
+
+        comma = memchr(p, ',', end - p);
+        if (comma == NULL) comma = end;
+
+        if ((s < comma)&&(*s == '0')) {
+            s++;
+        }
+
+        counter_add(&st->suites, s, comma - s, weight);
+
+        // RC4: TLS_RSA_WITH_RC4_128_MD5 (4) or TLS_RSA_WITH_RC4_128_SHA (5)
+        if ((numeric_value(s, comma - s, &value))&&((value == 4)||(value == 5))) {
+            rc4 = 1;
+        }
+
+        if (comma == end) break;
+        p = comma + 1;
+    }
+
+    // Compression: DEFLATE
+    for (p = f->compression.p, end = p + f->compression.len; p + 1 < end; p++) {
+        if ((p[0] == '0')&&(p[1] == '1')) {
+            st->compression_support += weight;
+            break;
+        }
+    }
+
+    if (f->beast.p[0] == '1') {
+        st->beast_mitigated += weight;
+    }
+
+    if (rc4) {
+        st->rc4 += weight;
+        st->rc4_seen = 1;
+    }
+
+    // Secure renegotiation: the extension, or the signalling suite
+    if ((((f->extensions.len != 1)||(f->extensions.p[0] != '-'))
+            &&(list_has(f->extensions, "ff01", 0)))
+        ||(list_has(f->suites, "ff", 1)))
+    {
+        st->secure_renegotiation += weight;
+    }
+}
+
+static void print_counter(const char *name, const haf_counter_t *c) {
+    size_t i;
+
+    printf("    [%s] => Array\n        (\n", name);
+
+    for (i = 0; i < c->len; i++) {
+        printf("            [%.*s] => %lu\n", (int)c->items[i].key_len, c->items[i].key,
+            c->items[i].value);
+    }
+
+    printf("        )\n\n");
+}
+
+/**
+ * Convert a suite or extension ID, as it appears in the report, to a
+ * number. The names are only known for IDs in lowercase hex without
+ * leading zeros (suites) or with exactly four digits (extensions), as
+ * with the PHP version of this script. Returns -1 otherwise.
+ */
+static long report_id(const char *id, size_t len, int extension) {
+    long value = 0;
+    size_t i;
+
+    if ((extension) ? (len != 4) : ((len == 0)||(len > 6)||(id[0] == '0'))) {
+        return -1;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (is_digit((unsigned char)id[i])) {
+            value = (value * 16) + (id[i] - '0');
+        } else if ((id[i] >= 'a')&&(id[i] <= 'f')) {
+            value = (value * 16) + (id[i] - 'a' + 10);
+        } else {
+            return -1;
+        }
+    }
+
+    return value;
+}
+
+static void report(haf_stats_t *st) {
+    size_t i;
+
+    counter_sort(&st->protocols, compare_keys);
+    counter_sort(&st->handshake, compare_keys);
+    counter_sort(&st->suites, compare_values);
+    counter_sort(&st->extensions, compare_values);
+
+    printf("stdClass Object\n(\n");
+    printf("    [total] => %lu\n", st->total);
+    printf("    [beast_mitigated] => %lu\n", st->beast_mitigated);
+    print_counter("protocols", &st->protocols);
+    printf("    [compression_support] => %lu\n", st->compression_support);
+    printf("    [secure_renegotiation] => %lu\n", st->secure_renegotiation);
+    print_counter("handshake", &st->handshake);
+    print_counter("suites", &st->suites);
+    print_counter("extensions", &st->extensions);
+    if (st->rc4_seen) {
+        printf("    [rc4] => %lu\n", st->rc4);
+    }
+    printf(")\n");
+
+    printf("\n");
+    printf("Cipher suites (most popular first)\n");
+    printf("----------------------------------\n");
+
+    for (i = 0; i < st->suites.len; i++) {
+        const haf_count_t *c = &st->suites.items[i];
+        long id = report_id(c->key, c->key_len, 0);
+        const sslhaf_suite_t *suite = (id >= 0) ? sslhaf_suite(id) : NULL;
+
+        if (suite != NULL) {
+            printf("%s", suite->name);
+        } else {
+            printf("Unknown 0x%.*s", (int)c->key_len, c->key);
+        }
+
+        printf(" (%lu; %.2f%%)\n", c->value, (c->value * 100.0) / st->total);
+    }
+
+    printf("\n");
+    printf("Extensions\n");
+    printf("----------\n");
+
+    for (i = 0; i < st->extensions.len; i++) {
+        const haf_count_t *c = &st->extensions.items[i];
+        long id = report_id(c->key, c->key_len, 1);
+        const char *name = (id >= 0) ? sslhaf_extension_name(id) : NULL;
+
+        if (name != NULL) {
+            printf("%s", name);
+        } else {
+            printf("Uknown 0x%.*s", (int)c->key_len, c->key);
+        }
+
+        printf(" (%lu; %.2f%%)\n", c->value, (c->value * 100.0) / st->total);
+    }
+}
+
+int main(int argc, char **argv) {
+    static haf_chunk_t chunks[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    haf_client_t **clients;
+    haf_hello_t **order;
+    haf_stats_t st;
+    struct stat sb;
+    const char *base = NULL;
+    size_t size, n, i, j;
+    long threads_n;
+    long norder = 0;
+    int c, fd;
+
+    threads_n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    while ((c = getopt(argc, argv, "aj:")) != -1) {
+        switch (c) {
+            case 'a' :
+                browsers_only = 0;
+                break;
+
+            case 'j' :
+                threads_n = atol(optarg);
+                break;
+
+            default :
+                fprintf(stderr, "Usage: %s [-a] [-j threads] FILENAME\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: %s [-a] [-j threads] FILENAME\n", argv[0]);
+        return 1;
+    }
+
+    if (threads_n < 1) threads_n = 1;
+    if (threads_n > MAX_THREADS) threads_n = MAX_THREADS;
+
+    fd = open(argv[optind], O_RDONLY);
+    if ((fd < 0)||(fstat(fd, &sb) < 0)) {
+        fprintf(stderr, "Failed to open input file: %s\n", argv[optind]);
+        return 1;
+    }
+
+    size = sb.st_size;
+    if (size > 0) {
+        base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "hafstats: Failed to map %s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+
+        #ifdef POSIX_MADV_SEQUENTIAL
+        posix_madvise((void *)base, size, POSIX_MADV_SEQUENTIAL);
+        #endif
+    }
+
+    close(fd);
+
+    // A thread for every few megabytes at most
+    if ((size_t)threads_n > (size / (4 * 1024 * 1024)) + 1) {
+        threads_n = (size / (4 * 1024 * 1024)) + 1;
+    }
+
+    // Split the log into chunks that start at the beginning of a line
+    for (i = 0; i < (size_t)threads_n; i++) {
+        size_t start = (i == 0) ? 0 : chunks[i - 1].end;
+        size_t end = (i == (size_t)threads_n - 1) ? size : (size / threads_n) * (i + 1);
+
+        if (end < start) {
+            end = start;
+        }
+
+        if (end < size) {
+            const char *nl = memchr(base + end, '\n', size - end);
+            end = (nl != NULL) ? (size_t)(nl - base) + 1 : size;
+        }
+
+        chunks[i].base = base;
+        chunks[i].start = start;
+        chunks[i].end = end;
+    }
+
+    for (i = 1; i < (size_t)threads_n; i++) {
+        if (pthread_create(&threads[i], NULL, process_chunk, &chunks[i]) != 0) {
+            fprintf(stderr, "hafstats: Failed to start a thread\n");
+            return 1;
+        }
+    }
+
+    process_chunk(&chunks[0]);
+
+    for (i = 1; i < (size_t)threads_n; i++) {
+        pthread_join(threads[i], NULL);
+        merge_chunk(&chunks[0], &chunks[i]);
+    }
+
+    // Invalid lines, in the order they appear
+    for (i = 0; i < (size_t)threads_n; i++) {
+        for (j = 0; j < chunks[i].invalid_len; j++) {
+            fputs("Invalid line: ", stdout);
+            fwrite(base + chunks[i].invalid[j].offset, 1, chunks[i].invalid[j].len, stdout);
+        }
+
+        free(chunks[i].invalid);
+    }
+
+    // Take the clients in the order they first appear, and find the
+    // order in which their handshakes are first counted; the order of
+    // equally popular suites and extensions follows from that
+    n = chunks[0].clients.used;
+    clients = xmalloc((n + 1) * sizeof(haf_client_t *));
+    order = xmalloc((chunks[0].hellos.used + 1) * sizeof(haf_hello_t *));
+
+    for (i = 0, j = 0; i < chunks[0].clients.size; i++) {
+        haf_client_t *cl = (haf_client_t *)chunks[0].clients.entries + i;
+        if (cl->key != 0) {
+            clients[j++] = cl;
+        }
+    }
+
+    qsort(clients, n, sizeof(haf_client_t *), compare_first);
+
+    memset(&st, 0, sizeof(st));
+
+    for (i = 0; i < n; i++) {
+        haf_hello_t *h;
+
+        if ((browsers_only)&&(!clients[i]->browser)) {
+            continue;
+        }
+
+        st.total++;
+
+        h = table_slot(&chunks[0].hellos, clients[i]->hello);
+        if (h->count++ == 0) {
+            order[norder++] = h;
+        }
+    }
+
+    for (i = 0; i < (size_t)norder; i++) {
+        add_hello(&st, order[i], order[i]->count);
+    }
+
+    report(&st);
+
+    free(st.protocols.items);
+    free(st.handshake.items);
+    free(st.suites.items);
+    free(st.extensions.items);
+    free(order);
+    free(clients);
+    free(chunks[0].clients.entries);
+    free(chunks[0].hellos.entries);
+
+    if (size > 0) {
+        munmap((void *)base, size);
+    }
+
+    return 0;
+}
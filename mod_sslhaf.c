@@ -54,9 +54,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *   untouched.
  *
  *
- * To compile and install the module, do this:
+ * The ClientHello parsing and fingerprinting live in sslhaf.c, a library that
+ * doesn't depend on Apache or APR; this file connects it to the server. To
+ * compile and install the module, do this:
  *
- *     # apxs -cia mod_sslhaf.c
+ *     # apxs -cia mod_sslhaf.c sslhaf.c
+ *
+ * The same library is used by sslhaf_offline, which fingerprints the
+ * handshakes in a packet capture or in logged SSLHAF_RAW values (see
+ * sslhaf_offline.c).
  *
  * The above script will try to add a LoadModule statement to your
  * configuration file but it will fail if it can't find at least one
@@ -66,6 +72,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *     LoadModule sslhaf_module /path/to/modules/mod_sslhaf.so
  *
  * You will need to enable HTTPS on your Apache server before using this module.
+ * With mod_ssl, only the connections it handles are looked at; the module steps
+ * out of each of them as soon as the ClientHello has been seen. With HTTP/2, every
+ * request gets the variables of the connection it's multiplexed on.
  * You will also need to add a custom log to record cipher suite information.
  * The file you modify will generally be /etc/apache2/sites-available/default-ssl.conf
  * For example (add to the virtual host where you want the fingerprinting
@@ -94,10 +103,29 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * - SSL_PROTOCOL The second token contains the best SSL/TLS version supported by the client. For
  *   example, SSLv3 is "3.0"; TLS 1.0 is "3.1"; TLS 1.1 is "3.2", etc.
  *
- * - SSLHAF_SUITES contains a list of the supported cipher suites. Each value, a hexadecimal number,
- *   corresponds to one cipher suite. From the example, 0x04 stands for SSL_RSA_WITH_RC4_128_MD5,
- *   0x010080 stands for SSL_CK_RC4_128_WITH_MD5 (a SSLv2 suite) and 0x05 stands
- *   for SSL_RSA_WITH_RC4_128_SHA.
+ * - SSLHAF_SUITES contains a list of the supported cipher suites. Each value, a decimal number,
+ *   corresponds to one cipher suite. For example, 4 stands for SSL_RSA_WITH_RC4_128_MD5 (0x04),
+ *   65664 stands for SSL_CK_RC4_128_WITH_MD5 (0x010080, a SSLv2 suite) and 5 stands
+ *   for SSL_RSA_WITH_RC4_128_SHA (0x05). GREASE values are left out.
+ *
+ * - SSLHAF_MIN_KEY_SIZE contains the smallest key size, in bits, of the offered suites that
+ *   are in suites.csv (0 when a NULL cipher is offered); not set if none of them is.
+ *   The suite names and key sizes are compiled into the module, in sslhaf_tables.h,
+ *   which sslhaf_tables.awk generates from suites.csv and extensions.csv.
+ *
+ * - SSLHAF_FLAGS contains, in decimal, the sum of the following flags, which are worked
+ *   out while the ClientHello is parsed. For each flag that is set, the variable next to
+ *   it is set to "1" as well, which rules can test without parsing SSLHAF_SUITES:
+ *
+ *     1   SSLHAF_RC4                   an RC4 suite is offered
+ *     2   SSLHAF_EXPORT                an export suite is offered
+ *     4   SSLHAF_NULL                  a suite without encryption is offered
+ *     8   SSLHAF_ANON                  a suite without authentication is offered
+ *     16  SSLHAF_WEAK                  a suite with a key under 128 bits is offered
+ *     32  SSLHAF_SECURE_RENEGOTIATION  secure renegotiation is supported (the
+ *                                      renegotiation_info extension, 0xff01, or the
+ *                                      TLS_EMPTY_RENEGOTIATION_INFO_SCSV suite, 0xff)
+ *     64  SSLHAF_COMPRESSION_SUPPORT   a compression method other than NULL is offered
  *
  * - SSLHAF_COMPRESSION contains the list of compression methods offered by the
  *   client (NULL 00, DEFLATE 01). The field can be NULL, in which case it will appear
@@ -105,8 +133,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  * - SSL_EXTENSIONS_LEN contains the number of extensions seen, for example "5".
  *
- * - SSL_EXTENSIONS contains the IDs of the submitted extensions, in the order in which they
- *   were sent. For example "000b,000a,0023,000d,000f".
+ * - SSL_EXTENSIONS contains the IDs of the submitted extensions, in decimal and in the order in
+ *   which they were sent, without GREASE values. For example "11-10-35-13-15".
+ *
+ * - CURVES and EC_POINT contain the supported groups and EC point formats, in the same format.
  *
  * - SSLHAF_LOG is defined (and contains "1") only on the first request in a connection. This
  *   variable can be used to reduce the amount of logging (SSL parameters will typically not
@@ -120,16 +150,168 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *   where the fields have their particulatr values (in decimal) comma separated.
  *   e.g. 769,47-53-5-10-49161-49162-49171-49172,0-10-11,23-24-25,0
  *
+ * - JA4_HASH contains the JA4 fingerprint, e.g. t13d1516h2_8daaf6152771_e5627efa2ab1: the
+ *   best version offered, whether there was SNI, the number of suites and extensions and
+ *   the first ALPN protocol, then truncated SHA-256 hashes of the sorted suites and of the
+ *   sorted extensions followed by the signature algorithms. Sorting makes it stable across
+ *   the extension order randomisation some browsers do. Not set for SSLv2 handshakes.
+ *
+ * To label known clients, point the module to a file of JA3 hashes and client labels:
+ *
+ *     SSLHAFClientDB conf/sslhaf-clients.txt
+ *
+ *   Each line holds a JA3 hash and, after whitespace, the label (the rest of the line).
+ *   Empty lines and lines starting with # are ignored. For example:
+ *
+ *     # JA3 hash                       label
+ *     be0d04da95468020a3936c6531444976 browser
+ *     9e10692f1b7f78228b2d4e424db3a98c bot
+ *
+ * - SSLHAF_CLIENT contains the label of the client when its JA3 hash is in the database.
+ *
+ * The following directives can be used in the main server and in virtual hosts, which
+ * inherit them from the main server. Because the handshake comes before any request,
+ * the virtual host is the one chosen by address and port, not by name.
+ *
+ *     SSLHAFEnable Off
+ *
+ *   Don't look at connections to this server at all. The default is On.
+ *
+ *     SSLHAFOutputs ja3 suites
+ *
+ *   Compute only the listed outputs, and set only their variables: suites (SSLHAF_SUITES
+ *   and SSLHAF_MIN_KEY_SIZE), compression (SSLHAF_COMPRESSION), extensions
+ *   (SSLHAF_EXTENSIONS and SSLHAF_EXTENSIONS_LEN), curves (CURVES and EC_POINT), ja3
+ *   (JA3_HASH and SSLHAF_CLIENT; only these connections are counted in the fingerprint
+ *   table), ja4 (JA4_HASH) and raw (SSLHAF_RAW). The default is all. SSLHAF_HANDSHAKE,
+ *   SSLHAF_PROTOCOL, SSLHAF_FLAGS (and the variables of the flags) and SSLHAF_LOG are
+ *   always set. Leaving out raw saves the most, as the packet is then never copied.
+ *
+ *     SSLHAFMaxRecord 16384
+ *
+ *   The largest ClientHello to inspect, in bytes of record data, between 512 and the
+ *   default of 65536. Larger ones are not fingerprinted.
+ *
+ *     SSLHAFBackend openssl
+ *
+ *   Where to get the ClientHello from. With filter, the default, an input filter reads
+ *   it from the connection before mod_ssl does, record by record. With openssl, OpenSSL
+ *   hands it over once it has read it, through a message callback set on the SSL
+ *   contexts of the server, which saves buffering it a second time and costs nothing
+ *   after the handshake. This needs mod_ssl with OpenSSL (httpd 2.4.22 or later) and
+ *   the module compiled against the same OpenSSL headers:
+ *
+ *       # apxs -cia -DSSLHAF_WITH_OPENSSL mod_sslhaf.c sslhaf.c
+ *
+ *   SSLHAF_RAW then holds the ClientHello in a single record, with the version of the
+ *   first record the client sent. Everything else is the same as with the filter, which
+ *   tests/msg_callback_test.c checks.
+ *
+ *     SSLHAFBinaryLog logs/sslhaf.bin
+ *
+ *   Main server only. Also append every fingerprinted ClientHello to this file, as a
+ *   binary record: the time, the client address, the JA3 digest and the packet as
+ *   received, without the hex encoding of SSLHAF_RAW. Records are queued in each
+ *   server process and written by a thread of its own in batches, a few times a
+ *   second; when the queue is full, records are dropped and counted in the error
+ *   log. The record format is described with BINLOG_MAGIC below. sslhaf_offline
+ *   reads these files.
+ *
+ *     SSLHAFExportSocket /run/sslhaf-collector.sock
+ *
+ *   Main server only. Also send the same records to a collector listening on this
+ *   Unix datagram socket, as soon as they are written out: each datagram holds one
+ *   or more whole records (but not the magic number at the start of the file). The
+ *   server never waits for the collector: records it can't take right away, or that
+ *   come while it isn't running, are dropped and counted in the error log when the
+ *   server process exits. sslhaf_collector is such a collector; it prints the records
+ *   or appends them to a binary log.
+ *
+ * The module can also turn clients away as soon as their ClientHello has been read,
+ * before mod_ssl spends any time on the handshake. This works with the filter backend
+ * only; by the time OpenSSL calls back, it has done the work. The fingerprint of the
+ * ClientHello is worked out, and counted in the fingerprint table, whatever the
+ * SSLHAFOutputs. These directives are for the main server only:
+ *
+ *     SSLHAFBlock bot scanner
+ *
+ *   Close the connections of the clients that have one of these labels in the client
+ *   database (see SSLHAFClientDB).
+ *
+ *     SSLHAFRateLimit 20 100
+ *
+ *   Let no JA3 fingerprint make more than this many connections a second, across all
+ *   server processes, after a burst of the second number of them (by default, one
+ *   second's worth); close the ones over the limit. The rate can have a fraction, for
+ *   example 0.1 for one connection every 10 seconds. Fingerprints that don't fit in
+ *   the fingerprint table are not limited.
+ *
+ * Connections turned away are closed straight away, without holding a server thread
+ * for them, counted (blocked and rate_limited in sslhaf-status) and logged at the info
+ * level.
+ *
+ * The module also counts connections per JA3 fingerprint, across all server processes,
+ * in a table held in shared memory. For every fingerprint it records the number of
+ * connections, the protocol version and when it was first and last seen. The table is
+ * reset on restart. To view it, add a handler:
+ *
+ *     <Location /sslhaf-fingerprints>
+ *         SetHandler sslhaf-fingerprints
+ *         Require ip 127.0.0.1
+ *     </Location>
+ *
+ * Once the table is full, which randomised extension orders and GREASE make likely
+ * on a busy server, new fingerprints are no longer counted there. So the module also
+ * keeps a sketch of fixed size in shared memory, which every fingerprint goes into:
+ * a count-min sketch, which estimates the number of connections of any fingerprint
+ * (never below the true number, and above it by at most a small fraction of all the
+ * connections), and the heaviest fingerprints, found with the Space-Saving algorithm.
+ * The sslhaf-top handler lists the top 100, with the number of connections counted
+ * for each and how many of them may belong to other fingerprints (at least count
+ * minus error were its own); given a JA3 hash as the query string, for example
+ * /sslhaf-top?be0d04da95468020a3936c6531444976, it shows the estimate for it:
+ *
+ *     <Location /sslhaf-top>
+ *         SetHandler sslhaf-top
+ *         Require ip 127.0.0.1
+ *     </Location>
+ *
+ * It also keeps counters of what it sees, summed across all server processes: the
+ * connections, how many were fingerprinted, the failures by reason (and, for malformed
+ * ClientHellos, by the code the parser failed with), the bytes inspected, the records
+ * that spanned more than one read, and the time spent parsing, in CPU cycles where
+ * there's a cycle counter and in microseconds elsewhere. They are reset on restart,
+ * and shown by the sslhaf-status handler, one counter per line, and by mod_status, on
+ * the server-status page (with ?auto as "SSLHAF_name: value"):
+ *
+ *     <Location /sslhaf-status>
+ *         SetHandler sslhaf-status
+ *         Require ip 127.0.0.1
+ *     </Location>
+ *
+ * The lines the module writes to the error log for each connection (the Client Hello,
+ * at the info level, and why a ClientHello couldn't be fingerprinted) are limited to 10
+ * a second per server process, after a burst of 50, so that a scan can't flood the log.
+ * The lines left out are summed up, by reason and with an estimate of how many client
+ * addresses they came from, in a single line every 10 seconds at most:
+ *
+ *     mod_sslhaf: Left out 950 lines in the last 10 s: 317 not_ssl from 305 addresses,
+ *     316 decode from 301 addresses, 317 client_hello from 300 addresses
+ *
  */
 
 #include "ap_config.h" 
 
 #include "apr_lib.h"
+#include "apr_atomic.h"
 #include "apr_hash.h"
 #include "apr_optional.h"
 #include "apr_sha1.h"
-#include "apr_md5.h"
+#include "apr_shm.h"
 #include "apr_strings.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
+#include "apr_version.h"
 #define APR_WANT_STRFUNC
 #include "apr_want.h"
 
@@ -139,118 +321,516 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "http_connection.h"
 #include "http_log.h"
 #include "http_protocol.h"
+#include "ap_mpm.h"
 
 #include "mod_log_config.h"
+#include "mod_ssl.h"
+#include "mod_status.h"
 
 #include <math.h>
 
+#if APR_HAVE_SYS_UN_H
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <x86intrin.h>
+#endif
+
+#ifdef SSLHAF_WITH_OPENSSL
+#include <openssl/ssl.h>
+#include "mod_ssl_openssl.h"
+#endif
+
+#include "sslhaf.h"
+
 module AP_MODULE_DECLARE_DATA sslhaf_module;
 
 static const char sslhaf_in_filter_name[] = "SSLHAF_IN";
 
+/* The variables set, to "1", for each of the handshake flags. */
+static const struct {
+    unsigned int flag;
+    const char *name;
+} sslhaf_flag_vars[] = {
+    { SSLHAF_FLAG_RC4, "SSLHAF_RC4" },
+    { SSLHAF_FLAG_EXPORT, "SSLHAF_EXPORT" },
+    { SSLHAF_FLAG_NULL, "SSLHAF_NULL" },
+    { SSLHAF_FLAG_ANON, "SSLHAF_ANON" },
+    { SSLHAF_FLAG_WEAK, "SSLHAF_WEAK" },
+    { SSLHAF_FLAG_RENEGOTIATION, "SSLHAF_SECURE_RENEGOTIATION" },
+    { SSLHAF_FLAG_COMPRESSION, "SSLHAF_COMPRESSION_SUPPORT" },
+    { 0, NULL }
+};
+
 #if (AP_SERVER_MAJORVERSION_NUMBER >= 2) && (AP_SERVER_MINORVERSION_NUMBER > 3)
 #define CONN_REMOTE_IP(C) ((C)->client_ip)
+#define CONN_REMOTE_ADDR(C) ((C)->client_addr)
 #else
 #define CONN_REMOTE_IP(C) ((C)->remote_ip)
+#define CONN_REMOTE_ADDR(C) ((C)->remote_addr)
 #endif
 
-struct sslhaf_cfg_t {
-    /* Inspection state; see above for the constants. */
-    int state;
-
-    /* The buffer we use to store the first SSL packet.
-     * Allocated from the connection pool.
-     */        
-    int buf_protocol;
-    unsigned char *buf;
-    apr_size_t buf_len;
-    apr_size_t buf_to_go;
-    
-    /* The client hello version used; 2 or 3. */
-    unsigned int hello_version;
-    
-    /* SSL version indicated in the handshake. */
-    unsigned int protocol_high;
-    unsigned int protocol_low;
-    
-    /* How many suites are there? */
-    apr_size_t slen; 			
-    
-    /* Pointer to the first suite. Do note that a v3 suites consumes
-     * 2 bytes whereas a v2 suite consumes 3 bytes. You need to check
-     * hello_version before you access the suites.
-     */
-    const char *suites; 
-    
-    /* Handkshake version as string. */
-    const char *thandshake;
-    
-    /* Protocol version number as string. */
-    const char *tprotocol;
-    
-    /* Suites as text. */
-    const char *tsuites;
+/* With HTTP/2, requests arrive on secondary connections, one per stream,
+ * whose master is the connection the client made (since 2.4.17). */
+#if AP_MODULE_MAGIC_AT_LEAST(20120211, 52)
+#define CONN_MASTER(C) ((C)->master)
+#else
+#define CONN_MASTER(C) ((conn_rec *)NULL)
+#endif
+
+/* Per-connection state. */
+typedef struct sslhaf_cfg_t {
+    /* The ClientHello parser and, once it's done, the fingerprints. */
+    sslhaf_t hello;
+
+    /* The outputs configured for the server; the parser may be asked
+     * for more, for the binary log. */
+    unsigned int outputs;
 
-    /* How many requests were there on this connection? */    
-    unsigned int request_counter;
+    /* How many requests were there on this connection? With HTTP/2,
+     * the streams count it up from several threads at once. */
+    apr_uint32_t request_counter;
 
     /* SHA1 hash of the remote address. */
     const char *ipaddress_hash;
     
-    /* How many compression methods are there. */    
-    int compression_len;
+    /* Label of the client, if its fingerprint is in the client database. */
+    const char *client_label;
+
+    /* Whether to check the ClientHello against SSLHAFBlock and
+     * SSLHAFRateLimit, and, once done, why the connection is to be
+     * turned away (SHED_*), if it is. */
+    int shedding;
+    int shed;
+
+    /* The last record counted as spanning buckets, numbered from 1. */
+    unsigned int spanning_record;
+
+    /* The version in the header of the first record, when OpenSSL
+     * hands us the ClientHello; 0 if it didn't say. */
+    unsigned char record_version[2];
+} sslhaf_cfg_t;
+
+/* The fingerprint table, shared by all server processes, has room
+ * for this many distinct fingerprints. A fingerprint is stored in the
+ * first free slot among FPTABLE_PROBES consecutive slots; when they
+ * are all taken by other fingerprints, the connection is only counted
+ * as dropped. */
+#define FPTABLE_SLOTS   16384
+#define FPTABLE_PROBES  32
+#define FPTABLE_SPINS   1000
+
+#define FP_SLOT_EMPTY   0
+#define FP_SLOT_BUSY    1
+#define FP_SLOT_READY   2
+
+/* One fingerprint in the shared table. All fields except the digest
+ * and protocol, which never change after the slot is published, are
+ * updated with atomic operations. Times are in seconds since the epoch,
+ * except tat, the theoretical arrival time of the next connection for
+ * SSLHAFRateLimit, which is in microseconds. */
+typedef struct sslhaf_fp_entry_t {
+    apr_uint32_t state;
+    apr_uint32_t count;
+    apr_uint32_t first_seen;
+    apr_uint32_t last_seen;
+    apr_uint64_t tat;
+    apr_uint32_t protocol;
+    unsigned char digest[SSLHAF_MD5_DIGESTSIZE];
+} sslhaf_fp_entry_t;
+
+typedef struct sslhaf_fp_table_t {
+    /* Connections whose fingerprint could not be stored. */
+    apr_uint32_t dropped;
+    sslhaf_fp_entry_t entries[FPTABLE_SLOTS];
+} sslhaf_fp_table_t;
+
+/* Created in post_config and inherited by the children. */
+static sslhaf_fp_table_t *fptable = NULL;
+
+/* A known client, from the database loaded with SSLHAFClientDB, and
+ * whether its label is one of SSLHAFBlock's. */
+typedef struct sslhaf_client_t {
+    unsigned char digest[SSLHAF_MD5_DIGESTSIZE];
+    const char *label;
+    int blocked;
+} sslhaf_client_t;
+
+/* The client database: an immutable array sorted by digest, plus an
+ * index of where each digest prefix (the first index_bits bits) begins
+ * in the array. The entries for prefix P are index[P] to index[P + 1]. */
+typedef struct sslhaf_clientdb_t {
+    sslhaf_client_t *clients;
+    apr_uint32_t count;
+    apr_uint32_t index_bits;
+    apr_uint32_t *index;
+} sslhaf_clientdb_t;
+
+#define DIGEST_PREFIX(D, BITS) ((apr_uint32_t)(((D)[0] << 8) | (D)[1]) >> (16 - (BITS)))
+
+/* Loaded in post_config and inherited by the children. */
+static sslhaf_clientdb_t *clientdb = NULL;
+
+/* The fingerprint sketch: a count-min sketch of SKETCH_DEPTH rows of
+ * SKETCH_WIDTH counters, and a Space-Saving summary of the heaviest
+ * fingerprints, split into TOPK_SETS sets of TOPK_WAYS entries so that
+ * a fingerprint is only ever looked for in one set. A fingerprint that
+ * isn't there takes the place of the lightest one in its set, if the
+ * count-min sketch says it's seen more connections, and, as in
+ * Space-Saving, takes over its count, plus one, with that count as the
+ * error. Each row of the sketch is picked by a different 32
+ * bits of the JA3 digest. An estimate is above the true count by at most
+ * e/SKETCH_WIDTH of all the connections (1 in 1500) with a probability
+ * of 1 - e^-SKETCH_DEPTH (98%). */
+#define SKETCH_DEPTH    4
+#define SKETCH_WIDTH    4096
+#define TOPK_SETS       128
+#define TOPK_WAYS       8
+#define TOPK_REPORT     100
+
+#define SKETCH_WORD(D, I) (((apr_uint32_t)(D)[(I) * 4] << 24) | ((D)[((I) * 4) + 1] << 16) \
+    | ((D)[((I) * 4) + 2] << 8) | (D)[((I) * 4) + 3])
+
+#define TOPK_SLOT(S)        ((S) & 3)
+#define TOPK_GENERATION     4
+
+/* A heavy fingerprint. The low bits of the state are FP_SLOT_*, as in
+ * the fingerprint table: an entry is BUSY while it's being given to a
+ * new fingerprint. Unlike those of the table, entries are given away
+ * again and again, so the bits above count the times, and a state read
+ * before the entry changed hands never matches it again. Of its count,
+ * up to error connections may have been those of other fingerprints,
+ * from before it was admitted. */
+typedef struct sslhaf_topk_entry_t {
+    apr_uint32_t state;
+    apr_uint32_t count;
+    apr_uint32_t error;
+    unsigned char digest[SSLHAF_MD5_DIGESTSIZE];
+} sslhaf_topk_entry_t;
+
+typedef struct sslhaf_sketch_t {
+    /* Connections counted. */
+    apr_uint32_t total;
+    apr_uint32_t rows[SKETCH_DEPTH][SKETCH_WIDTH];
+    sslhaf_topk_entry_t topk[TOPK_SETS][TOPK_WAYS];
+} sslhaf_sketch_t;
+
+/* Created in post_config and inherited by the children. */
+static sslhaf_sketch_t *sketch = NULL;
+
+/* Why a connection is turned away. */
+#define SHED_BLOCKED        1
+#define SHED_RATE_LIMITED   2
+
+/* Connection shedding, from the main server's configuration: whether
+ * any client is blocked, and the time between two connections of the
+ * same fingerprint and how far ahead of that a burst may get (0 when
+ * there's no rate limit), both in microseconds. */
+static int shed_blocking = 0;
+static apr_uint64_t shed_interval = 0;
+static apr_uint64_t shed_tolerance = 0;
+
+/* The binary log. Every record starts with a header of BINLOG_HEADER_LEN
+ * bytes, integers in network byte order:
+ *
+ *   0  record length, header included (4 bytes)
+ *   4  record format, BINLOG_FORMAT (2)
+ *   6  IP version of the client address, 4 or 6 (1)
+ *   7  handshake version, 2 or 3 (1)
+ *   8  time, in microseconds since the epoch (8)
+ *  16  client address; IPv4 addresses take the first 4 bytes (16)
+ *  32  JA3 digest (16)
+ *
+ * followed by the ClientHello as received: all its records, headers
+ * included. The file starts with BINLOG_MAGIC. */
+#define BINLOG_MAGIC        "SSLHAFB1"
+#define BINLOG_FORMAT       1
+#define BINLOG_HEADER_LEN   48
+
+/* Records are handed from the connections to the flusher thread of the
+ * child through a ring of BINLOG_RING bytes, allocated once, which they
+ * are written into in place; when it's full, records are dropped and
+ * counted. The flusher wakes up every BINLOG_INTERVAL and writes what
+ * there is in batches of up to BINLOG_BATCH bytes. Each batch is one
+ * append, so the records of different children never interleave. */
+#define BINLOG_RING         (4 * 1024 * 1024)
+#define BINLOG_BATCH        (64 * 1024)
+#define BINLOG_INTERVAL     apr_time_from_msec(100)
+
+/* The same batches also go to the export socket, if there is one: a
+ * Unix datagram socket a collector listens on, one batch (whole records,
+ * without BINLOG_MAGIC) per datagram. Sending never blocks. A batch the
+ * collector can't take right away is dropped and its records counted;
+ * when there's no collector, we try to connect again after
+ * EXPORT_RETRY, and drop what comes in the meantime. */
+#define EXPORT_RETRY        apr_time_from_sec(1)
+#define EXPORT_SNDBUF       (256 * 1024)
+
+/* Every record in the ring comes after an entry header of two 32-bit
+ * words: the size of the entry, header included and rounded up to
+ * BINLOG_ALIGN, and the length of the record. The size is set last,
+ * and is 0 until then; when a record would run past the end of the
+ * ring, the space up to it is skipped with an entry whose size has
+ * BINLOG_PAD set. The flusher zeroes the entries it's done with. */
+#define BINLOG_ENTRY_HEADER 8
+#define BINLOG_ALIGN        8
+#define BINLOG_PAD          0x80000000
+
+typedef struct sslhaf_binlog_t {
+    /* Where records go: the binary log, the export socket, or both. */
+    apr_file_t *file;
+    const char *export_path;
+
+#if APR_HAVE_SYS_UN_H
+    /* The export socket, connected, or -1; the flusher's alone, as
+     * are the time of the next attempt to connect and the count of
+     * the records that didn't make it. */
+    int sock;
+    apr_time_t retry;
+    apr_uint32_t export_dropped;
+#endif
 
-    /* List of all compression methods as a comma-separated string. */    
-    const char *compression_methods;
-    
-    /* How many extensions were there in the handshake? */
-    int extensions_len;
+    /* The byte positions of the next entry to fill, reserved by the
+     * producers with a CAS, and of the next one to write, which only
+     * the flusher moves. Both only ever grow, and wrap around. */
+    apr_uint32_t head;
+    apr_uint32_t tail;
 
-    /* A string that contains the list of all extensions seen in the handshake. */    
-    const char *extensions;
+    /* Records lost because the ring was full. */
+    apr_uint32_t dropped;
 
-    /* The entire raw handshake packet, consisting of a record layer packet with a
-     * Client Hello inside it. Encoded as a string of hexadecimal characters. */    
-    const char *client_hello;
+    apr_uint32_t stop;
+    unsigned char *batch;
 
-    const char *ec_point;
-    const char *curves;
-    int curve_len;
+#if APR_HAS_THREADS
+    apr_thread_t *thread;
+#endif
+
+    unsigned char *ring;
+} sslhaf_binlog_t;
+
+/* Opened in post_config and inherited by the children. */
+static apr_file_t *binlog_file = NULL;
+
+/* Checked in post_config; each child connects on its own. */
+static const char *export_path = NULL;
+
+/* This child's ring. */
+static sslhaf_binlog_t *binlog = NULL;
+
+/* mod_ssl's test of whether a connection is SSL, if it's loaded. */
+static APR_OPTIONAL_FN_TYPE(ssl_is_https) *sslhaf_is_https = NULL;
+
+/* The counters. Every child adds to one of the STATS_SLOTS sets in
+ * shared memory, so that the children rarely write to the same cache
+ * lines; when there are more children, some share a set. Readers sum
+ * them all. The counters are updated with atomic operations, as the
+ * threads of a child share its set. */
+#define STATS_SLOTS_MAX     256
+#define STATS_SLOT_ALIGN    64
+
+typedef struct sslhaf_stats_t {
+    /* Connections the filter was attached to, and how they ended:
+     * fingerprinted, without a ClientHello, or failed (by SSLHAF_E_*
+     * reason). Connections closed before the ClientHello was complete
+     * are in none of these. */
+    apr_uint64_t connections;
+    apr_uint64_t fingerprinted;
+    apr_uint64_t no_hello;
+    apr_uint64_t failed[SSLHAF_E_MAX + 1];
+
+    /* Parser failures, by code (decode_rc, negated). */
+    apr_uint64_t decode_rc[SSLHAF_DECODE_CODES + 1];
+
+    /* Bytes and buckets handed to the parser, records whose bytes
+     * arrived in more than one bucket, and the time spent parsing,
+     * in STATS_CLOCK_UNIT. */
+    apr_uint64_t bytes;
+    apr_uint64_t buckets;
+    apr_uint64_t spanning;
+    apr_uint64_t parse_time;
+
+    /* Connections turned away by SSLHAFBlock and SSLHAFRateLimit. */
+    apr_uint64_t blocked;
+    apr_uint64_t rate_limited;
+} sslhaf_stats_t;
+
+typedef struct sslhaf_stats_table_t {
+    /* The next set for a child to take. */
+    apr_uint32_t next;
+    apr_uint32_t slots;
+    apr_size_t slot_size;
+} sslhaf_stats_table_t;
+
+#define STATS_SLOT(T, I) ((sslhaf_stats_t *)((char *)(T) \
+    + APR_ALIGN(sizeof(sslhaf_stats_table_t), STATS_SLOT_ALIGN) + ((I) * (T)->slot_size)))
+
+/* 64-bit atomics came with APR 1.7. STATS_CAS returns the old value. */
+#if APR_VERSION_AT_LEAST(1,7,0)
+#define STATS_ADD(C, V) apr_atomic_add64(&(C), (V))
+#define STATS_READ(C) apr_atomic_read64(&(C))
+#define STATS_CAS(C, NEW, OLD) apr_atomic_cas64(&(C), (NEW), (OLD))
+#else
+#define STATS_ADD(C, V) __sync_fetch_and_add(&(C), (V))
+#define STATS_READ(C) __sync_fetch_and_add(&(C), 0)
+#define STATS_CAS(C, NEW, OLD) __sync_val_compare_and_swap(&(C), (OLD), (NEW))
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STATS_CLOCK() ((apr_uint64_t)__rdtsc())
+#define STATS_CLOCK_UNIT "cycles"
+#else
+#define STATS_CLOCK() ((apr_uint64_t)apr_time_now())
+#define STATS_CLOCK_UNIT "usec"
+#endif
+
+/* Created in post_config and inherited by the children. */
+static sslhaf_stats_table_t *stats_table = NULL;
+
+/* This child's set of counters. */
+static sslhaf_stats_t *stats = NULL;
+
+/* The names of the failure reasons, by SSLHAF_E_* value. */
+static const char * const sslhaf_failure_names[SSLHAF_E_MAX + 1] = {
+    NULL,
+    "not_ssl",
+    "record_type",
+    "not_v2_hello",
+    "empty_record",
+    "too_long",
+    "nomem",
+    "decode"
+};
+
+/* What goes to the error log about each connection (the ClientHello,
+ * or why it couldn't be fingerprinted) is rate-limited in each child
+ * with a token bucket: LOG_BURST lines at once, and LOG_RATE a second
+ * after that. The lines that are left out are counted by reason, along
+ * with roughly how many client addresses they came from, and summed
+ * up in one line per LOG_SUMMARY_INTERVAL at most, logged with the
+ * next line that comes after it, or when the child exits. */
+#define LOG_RATE                10
+#define LOG_BURST               50
+#define LOG_SUMMARY_INTERVAL    apr_time_from_sec(10)
+
+/* Addresses are counted in a bitmap of this many bits per reason,
+ * from which their number is estimated by linear counting. */
+#define LOG_ADDR_BITS           4096
+
+/* The reasons are SSLHAF_E_*, and these, for the Client Hello lines
+ * and the connections turned away. */
+#define LOG_HELLO               (SSLHAF_E_MAX + 1)
+#define LOG_BLOCKED             (SSLHAF_E_MAX + 2)
+#define LOG_RATE_LIMITED        (SSLHAF_E_MAX + 3)
+#define LOG_REASONS             (SSLHAF_E_MAX + 4)
+
+static const char * const log_reason_names[LOG_REASONS - LOG_HELLO] = {
+    "client_hello",
+    "blocked",
+    "rate_limited"
+};
+
+#ifdef APLOG_IS_LEVEL
+#define LOG_LEVEL_ON(S, LEVEL) APLOG_IS_LEVEL(S, LEVEL)
+#else
+#define LOG_LEVEL_ON(S, LEVEL) ((LEVEL) <= (S)->loglevel)
+#endif
+
+typedef struct sslhaf_log_limit_t {
+    #if APR_HAS_THREADS
+    apr_thread_mutex_t *mutex;
+    #endif
+
+    /* The bucket, and when it was last refilled. */
+    unsigned int tokens;
+    apr_time_t refill;
+
+    /* When the lines counted below started to be left out. */
+    apr_time_t since;
+
+    /* The lines left out, by reason; the most severe level of them;
+     * and the addresses they came from. */
+    unsigned long suppressed[LOG_REASONS];
+    int level;
+    unsigned char addrs[LOG_REASONS][LOG_ADDR_BITS / 8];
+} sslhaf_log_limit_t;
+
+/* This child's token bucket; NULL outside the children, where every
+ * line is logged. */
+static sslhaf_log_limit_t *log_limit = NULL;
+
+/* What the module can make available to requests, for SSLHAFOutputs.
+ * Only the work the configured outputs need is done for a connection;
+ * SSLHAF_OUTPUT_JA3 also covers the fingerprint table and SSLHAF_CLIENT. */
+static const struct {
+    const char *name;
+    unsigned int flags;
+} sslhaf_outputs[] = {
+    { "suites", SSLHAF_OUTPUT_SUITES },
+    { "compression", SSLHAF_OUTPUT_COMPRESSION },
+    { "extensions", SSLHAF_OUTPUT_EXTENSIONS },
+    { "curves", SSLHAF_OUTPUT_CURVES },
+    { "ja3", SSLHAF_OUTPUT_JA3 },
+    { "ja4", SSLHAF_OUTPUT_JA4 },
+    { "raw", SSLHAF_OUTPUT_RAW },
+    { "all", SSLHAF_OUTPUT_ALL },
+    { NULL, 0 }
 };
 
-typedef struct sslhaf_cfg_t sslhaf_cfg_t;
+/* Where the ClientHello comes from: our input filter, which sees the
+ * bytes before mod_ssl does, or OpenSSL's message callback, which
+ * hands us the ClientHello once OpenSSL has read all its records. */
+#define SSLHAF_BACKEND_FILTER   0
+#define SSLHAF_BACKEND_OPENSSL  1
+
+/* Per-server configuration. Unset values (-1 and 0) are inherited
+ * from the main server. */
+typedef struct sslhaf_srv_cfg_t {
+    /* Client database file; main server only. */
+    const char *clientdb_file;
+
+    /* Binary log file; main server only. */
+    const char *binlog_file;
+
+    /* Export socket; main server only. */
+    const char *export_socket;
 
-#define STATE_START 	0
-#define STATE_BUFFER 	1
-#define STATE_READING	2
-#define STATE_GOAWAY	3
+    /* SSLHAFEnable; on by default. */
+    int enable;
 
-#define BUF_LIMIT 	16384
+    /* SSLHAFOutputs; all by default. */
+    int outputs;
 
-#define PROTOCOL_CHANGE_CIPHER_SPEC     20
-#define PROTOCOL_HANDSHAKE              22
-#define PROTOCOL_APPLICATION            23
+    /* SSLHAFMaxRecord; SSLHAF_HELLO_LIMIT by default. */
+    apr_size_t max_record;
+
+    /* SSLHAFBackend; SSLHAF_BACKEND_FILTER by default. */
+    int backend;
+
+    /* SSLHAFBlock labels; main server only. */
+    apr_array_header_t *block;
+
+    /* SSLHAFRateLimit, in connections a second (0 for none), and
+     * its burst; main server only. */
+    double rate;
+    apr_uint32_t burst;
+} sslhaf_srv_cfg_t;
 
 /**
  * Convert input bytes given into their hexadecimal representation.
  */
 char *bytes2hex(apr_pool_t *pool, unsigned char *data, int len) {
-    static unsigned char b2hex[] = "0123456789abcdef";
     char *hex = NULL;
-    int i, j;
 
     hex = apr_palloc(pool, (len * 2) + 1);
     if (hex == NULL) return NULL;
 
-    j = 0;
-    for(i = 0; i < len; i++) {
-        hex[j++] = b2hex[data[i] >> 4];
-        hex[j++] = b2hex[data[i] & 0x0f];
-    }
-    
-    hex[j] = '\0';
-
-    return hex;
+    return sslhaf_hex_encode(data, len, hex);
 }
 
 /**
@@ -267,984 +847,2040 @@ char *generate_sha1(apr_pool_t *pool, char *data, int len) {
     return bytes2hex(pool, digest, APR_SHA1_DIGESTSIZE);
 }
 
-char *generate_ja3(apr_pool_t *pool, unsigned char * digest, char *ver, char *ciph, char *ext, char *ec, char *ec_pf) {
-    apr_md5_ctx_t context;
-
-    apr_md5_init(&context);
-    apr_md5_update(&context, (const char *)ver, strlen(ver));
-    apr_md5_update(&context, ",", 1);
-    apr_md5_update(&context, (const char *)ciph, strlen(ciph));
-    apr_md5_update(&context, ",", 1);
-    apr_md5_update(&context, (const char *)ext, strlen(ext));
-    apr_md5_update(&context, ",", 1);
-    apr_md5_update(&context, (const char *)ec, strlen(ec));
-    apr_md5_update(&context, ",", 1);
-    apr_md5_update(&context, (const char *)ec_pf, strlen(ec_pf));
-    apr_md5_final(digest, &context);
-    
-    return bytes2hex(pool, digest, APR_MD5_DIGESTSIZE);
+/**
+ * Looks up the entry for the given digest in the fingerprint table,
+ * creating it if necessary. Returns NULL if the table is not available,
+ * or if the digest is not in the table and there is no room for it.
+ * Slots are claimed with a compare-and-swap, so any number of threads
+ * in any number of processes can do this at the same time without
+ * taking a lock.
+ */
+static sslhaf_fp_entry_t *fptable_lookup(const unsigned char *digest,
+    unsigned int protocol, apr_uint32_t now)
+{
+    sslhaf_fp_entry_t *entry;
+    apr_uint32_t slot;
+    int i, spins;
+
+    if (fptable == NULL) {
+        return NULL;
+    }
+
+    // MD5 output is uniform, so the digest is its own hash
+    slot = ((digest[0] << 24) | (digest[1] << 16) | (digest[2] << 8) | digest[3])
+        % FPTABLE_SLOTS;
+
+    for (i = 0; i < FPTABLE_PROBES; i++) {
+        entry = &fptable->entries[(slot + i) % FPTABLE_SLOTS];
+
+        if (apr_atomic_read32(&entry->state) == FP_SLOT_EMPTY) {
+            if (apr_atomic_cas32(&entry->state, FP_SLOT_BUSY, FP_SLOT_EMPTY) == FP_SLOT_EMPTY) {
+                // The slot is ours; fill it in, then publish it
+                memcpy(entry->digest, digest, SSLHAF_MD5_DIGESTSIZE);
+                entry->protocol = protocol;
+                entry->first_seen = now;
+                entry->last_seen = now;
+                entry->count = 0;
+                entry->tat = 0;
+                apr_atomic_xchg32(&entry->state, FP_SLOT_READY);
+
+                return entry;
+            }
+        }
+
+        // Another thread may have claimed this slot a moment ago, possibly
+        // for the same digest; give it a chance to finish before we compare
+        for (spins = 0; spins < FPTABLE_SPINS; spins++) {
+            if (apr_atomic_read32(&entry->state) == FP_SLOT_READY) break;
+        }
+
+        if ((apr_atomic_read32(&entry->state) == FP_SLOT_READY)
+            &&(memcmp(entry->digest, digest, SSLHAF_MD5_DIGESTSIZE) == 0))
+        {
+            return entry;
+        }
+    }
+
+    apr_atomic_inc32(&fptable->dropped);
+
+    return NULL;
 }
 
 /**
- * Convert one byte into its hexadecimal representation.
+ * Counts one connection against its fingerprint in the shared table.
+ * Returns the fingerprint's entry, or NULL if it isn't in the table.
  */
-unsigned char *c2x(unsigned what, unsigned char *where) {
-    static const char c2x_table[] = "0123456789abcdef";
-    
-    what = what & 0xff;
-    *where++ = c2x_table[what >> 4];
-    *where++ = c2x_table[what & 0x0f];
-                
-    return where;
-}
+static sslhaf_fp_entry_t *fptable_update(const sslhaf_t *hello) {
+    apr_uint32_t now = (apr_uint32_t)apr_time_sec(apr_time_now());
+    sslhaf_fp_entry_t *entry;
+
+    entry = fptable_lookup(hello->ja3_digest,
+        (hello->protocol_high * 256) + hello->protocol_low, now);
+    if (entry == NULL) {
+        return NULL;
+    }
 
-// int hex_to_dec(char *data) {
-    
-// }
+    apr_atomic_inc32(&entry->count);
+
+    // Avoid dirtying the cache line when the time hasn't moved on
+    if (apr_atomic_read32(&entry->last_seen) != now) {
+        apr_atomic_set32(&entry->last_seen, now);
+    }
+
+    return entry;
+}
 
 /**
- * Logs the current Client Hello to the error log.
+ * Decide whether a connection of the fingerprint is within
+ * SSLHAFRateLimit, with the generic cell rate algorithm, which is
+ * a token bucket that only needs to keep one time: the connection
+ * is let through unless the theoretical arrival time of the next
+ * one is more than shed_tolerance in the future, and pushes it
+ * shed_interval further. The time is updated with a compare-and-swap,
+ * like the rest of the table. Returns 1 if it's within the limit.
  */
-static void log_client_hello(ap_filter_t *f, sslhaf_cfg_t *cfg) {
-    ap_log_error(APLOG_MARK, APLOG_INFO, 0, f->c->base_server,
-        "mod_sslhaf [%s]: Client Hello: handshake %d, protocol %d.%d, extensions %d",
-        CONN_REMOTE_IP(f->c), cfg->hello_version, cfg->protocol_high, cfg->protocol_low, cfg->extensions_len);
+static int fptable_conforms(sslhaf_fp_entry_t *entry) {
+    apr_uint64_t now = (apr_uint64_t)apr_time_now();
+    apr_uint64_t tat, start;
+
+    do {
+        tat = STATS_READ(entry->tat);
+
+        start = (tat > now) ? tat : now;
+        if (start - now > shed_tolerance) {
+            return 0;
+        }
+    } while (STATS_CAS(entry->tat, start + shed_interval, tat) != tat);
+
+    return 1;
 }
 
 /**
- * Decode SSLv2 packet.
+ * Estimate the connections of a fingerprint from the count-min sketch:
+ * the smallest of its counters, which the other fingerprints that share
+ * them can only have pushed up.
  */
-static int decode_packet_v2(ap_filter_t *f, sslhaf_cfg_t *cfg) {
-    apr_size_t cslen;
-    unsigned char *q;
-	
-	// First make a copy of the entire message and convert it to hex.
-	q = apr_pcalloc(f->c->pool, 10 + cfg->buf_len * 2 + 1);
-	if (q == NULL) return -1;
-	cfg->client_hello = (char *)q;
-	
-	// Length bytes.
-	
-	c2x(0x80, q);
-	q += 2;
-	
-	c2x(cfg->buf_len + 3, q);
-	q += 2;
-	
-	// Message type: ClientHello.
-	c2x(1, q);
-	q += 2;
-	
-	// Protocol version.
-	if ((cfg->protocol_high == 0x02)&&(cfg->protocol_low == 0x00)) {			
-		c2x(cfg->protocol_low, q);
-		q += 2;
-		c2x(cfg->protocol_high, q);
-		q += 2;
-	} else {	
-		c2x(cfg->protocol_high, q);
-		q += 2;
-		c2x(cfg->protocol_low, q);
-		q += 2;
-	}
-	
-	// Convert the remaining bytes.
-	unsigned char *mybuf = cfg->buf;
-	cslen = cfg->buf_len;
-	while(cslen--) {
-		c2x(*mybuf, q);
-		q += 2;
-		mybuf++;
-	}
-	
-	*q = '\0';	
-	
-	// Now parse the message.
-	
-	unsigned char *buf = cfg->buf;
-	apr_size_t len = cfg->buf_len;
-
-    // There are 6 bytes before the list of cipher suites:
-    // cipher suite length (2 bytes), session ID length (2 bytes)
-    // and challenge length (2 bytes).
-    if (len < 6) {
-        return -1;
+static apr_uint32_t sketch_estimate(const unsigned char *digest) {
+    apr_uint32_t estimate = 0;
+    int i;
+
+    for (i = 0; i < SKETCH_DEPTH; i++) {
+        apr_uint32_t v = apr_atomic_read32(&sketch->rows[i][SKETCH_WORD(digest, i) % SKETCH_WIDTH]);
+
+        if ((i == 0)||(v < estimate)) {
+            estimate = v;
+        }
     }
-    
-    // How many bytes do the cipher suites consume?
-    cslen = (buf[0] * 256) + buf[1];
 
-    // Skip over to the list.    
-    buf += 6;
-    len -= 6;
+    return estimate;
+}
+
+/**
+ * Counts one connection against its fingerprint in the sketch. Like
+ * the fingerprint table, this takes no lock: the counters are atomic,
+ * and an entry of the heavy fingerprints is claimed with a
+ * compare-and-swap on the state it was seen in before it's given to
+ * another fingerprint; when another thread got there first, the
+ * connection is only in the count-min sketch.
+ */
+static void sketch_update(const unsigned char *digest) {
+    sslhaf_topk_entry_t *set, *min = NULL;
+    apr_uint32_t estimate = 0, min_count = 0, min_state = 0, claimed;
+    int i;
 
-    // Check that we have the suites in the buffer.
-    if (len < cslen) {
-        return -2;
+    if (sketch == NULL) {
+        return;
     }
 
-    // In SSLv2 each suite consumes 3 bytes.
-    cslen = cslen / 3;
-    
-    // Keep the pointer to where the suites begin. The memory
-    // was allocated from the connection pool, so it should
-    // be around for as long as we need it.
-    cfg->slen = cslen;
-    cfg->suites = (const char *)buf;
-    
-    cfg->thandshake = apr_psprintf(f->c->pool, "%i", cfg->hello_version);
-    cfg->tprotocol = apr_psprintf(f->c->pool, "%i.%i", cfg->protocol_high, cfg->protocol_low);
-                
-    // Create a list of suites as text, for logging. Each 3-byte
-    // suite can consume up to 6 bytes (in hexadecimal form) with
-    // an additional byte for a comma. We also need one more byte
-    // for the final NUL.
-    q = apr_pcalloc(f->c->pool, (cslen * 7) + 1);
-    if (q == NULL) return -3;
-    cfg->tsuites = (const char *)q;
-    
-    // Extract cipher suites; each suite consists of 3 bytes.
-    while (cslen--) {
-        if ((const char *)q != cfg->tsuites) {
-            *q++ = ',';
+    apr_atomic_inc32(&sketch->total);
+
+    for (i = 0; i < SKETCH_DEPTH; i++) {
+        apr_uint32_t v = apr_atomic_inc32(&sketch->rows[i][SKETCH_WORD(digest, i) % SKETCH_WIDTH]) + 1;
+
+        if ((i == 0)||(v < estimate)) {
+            estimate = v;
         }
+    }
 
-        if (*buf != 0) {
-            c2x(*buf, q);
-            q += 2;
-            
-            c2x(*(buf + 1), q);
-            q += 2;
-        } else {
-            if (*(buf + 1) != 0) {
-                c2x(*(buf + 1), q);
-                q += 2;
+    // The set comes from bits of the last row's word that the row doesn't use
+    set = sketch->topk[SKETCH_WORD(digest, SKETCH_DEPTH - 1) / SKETCH_WIDTH % TOPK_SETS];
+
+    for (i = 0; i < TOPK_WAYS; i++) {
+        sslhaf_topk_entry_t *entry = &set[i];
+        apr_uint32_t state = apr_atomic_read32(&entry->state);
+        apr_uint32_t count;
+
+        if ((TOPK_SLOT(state) == FP_SLOT_READY)
+            &&(memcmp(entry->digest, digest, SSLHAF_MD5_DIGESTSIZE) == 0)
+            &&(apr_atomic_read32(&entry->state) == state))
+        {
+            apr_atomic_inc32(&entry->count);
+
+            // Given to another fingerprint meanwhile, the entry may have
+            // had this connection counted against the newcomer
+            if (apr_atomic_read32(&entry->state) != state) {
+                apr_atomic_inc32(&entry->error);
             }
+
+            return;
+        }
+
+        // Empty entries count as 0; entries being replaced don't count
+        count = (TOPK_SLOT(state) == FP_SLOT_READY) ? apr_atomic_read32(&entry->count) : 0;
+        if ((TOPK_SLOT(state) != FP_SLOT_BUSY)&&((min == NULL)||(count < min_count))) {
+            min = entry;
+            min_count = count;
+            min_state = state;
         }
-        
-        c2x(*(buf + 2), q);
-        q += 2;
-                    
-        buf += 3;
     }
-            
-    *q = '\0';
 
-    log_client_hello(f, cfg);
+    // Only a fingerprint with more connections than the lightest one
+    // takes its place; one-off fingerprints stay in the sketch
+    if ((min == NULL)||(estimate <= min_count)) {
+        return;
+    }
 
-    return 1;
+    claimed = (min_state - TOPK_SLOT(min_state) + TOPK_GENERATION) | FP_SLOT_BUSY;
+    if (apr_atomic_cas32(&min->state, claimed, min_state) != min_state) {
+        return;
+    }
+
+    // The error goes first, so that a connection counted late against
+    // the newcomer has its error counted too
+    memcpy(min->digest, digest, SSLHAF_MD5_DIGESTSIZE);
+    apr_atomic_set32(&min->error, min_count);
+    apr_atomic_set32(&min->count, min_count + 1);
+    apr_atomic_xchg32(&min->state, claimed - FP_SLOT_BUSY + FP_SLOT_READY);
 }
 
 /**
- * Decode SSLv3+ packet containing handshake data.
+ * Compare two client database entries by digest; used to sort the database.
  */
-static int decode_packet_v3_handshake(ap_filter_t *f, sslhaf_cfg_t *cfg) {
-    unsigned char *buf = cfg->buf;
-    apr_size_t len = cfg->buf_len;
-    apr_size_t ml;
-        
-    // Check for the minimum size first (1 byte for
-    // message type and 3 bytes for message size)
-    if (len < 4) {
-        ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-            "mod_sslhaf [%s]: Decoding packet v3 HANDSHAKE: Packet too small %" APR_SIZE_T_FMT,
-            CONN_REMOTE_IP(f->c), len);
-        return -1;
-    }
-        
-    // We can only process ClientHello messages
-    if (buf[0] != 1) {
-        return 1;
-    }
-        
-    // Message length
-    ml = (buf[1] * 65536) + (buf[2] * 256) + buf[3];
-        
-    // Does the message length correspond
-    // to the size of our buffer?
-    if (ml > len - 4) {
-        ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-            "mod_sslhaf [%s]: Decoding packet v3 HANDSHAKE: Length mismatch. Expecting %"
-            APR_SIZE_T_FMT " got %" APR_SIZE_T_FMT, CONN_REMOTE_IP(f->c), ml, len - 4);
-        return -2;
+static int clientdb_compare(const void *a, const void *b) {
+    return memcmp(((const sslhaf_client_t *)a)->digest,
+        ((const sslhaf_client_t *)b)->digest, SSLHAF_MD5_DIGESTSIZE);
+}
+
+/**
+ * Look up a known client by its JA3 digest. The prefix index narrows
+ * the search down to the handful of entries that share the first
+ * index_bits bits of the digest, so this is effectively a single probe.
+ * Returns NULL for unknown clients.
+ */
+static const sslhaf_client_t *clientdb_lookup(const unsigned char *digest) {
+    apr_uint32_t prefix, lo, hi;
+
+    if (clientdb == NULL) {
+        return NULL;
     }
-        
-    unsigned char *p; 
-    unsigned char *q;
-    apr_size_t mylen = ml;
-    apr_size_t idlen;
-    apr_size_t cslen;
-                        
-    // Make a copy of the entire TLS record with ClientHello in it and convert it to hex
-
-    p = buf;            
-    cslen = len;
-    q = apr_pcalloc(f->c->pool, 10 + cslen * 2 + 1);
-	if (q == NULL) return -1;
-    cfg->client_hello = (const char *)q;
-            
-    c2x(0x16, q); // Handshake protocol
-    q += 2;
-    c2x(cfg->protocol_high, q);
-    q += 2;
-    c2x(cfg->protocol_low, q);
-    q += 2;
-    c2x((mylen + 4) >> 8, q);
-    q += 2;
-    c2x((mylen + 4) & 0xff, q);
-    q += 2;
-
-            while(cslen--) {
-                c2x(*p, q);
-                p++;
-                q += 2;
-            }
-            *q = '\0';
-            
-            // parse Client Hello
 
-            p = buf + 4; // skip over the message type and length
-            
-            if (mylen < 34) { // for the version number and random value
-                return -3;
-            }
+    prefix = DIGEST_PREFIX(digest, clientdb->index_bits);
+    lo = clientdb->index[prefix];
+    hi = clientdb->index[prefix + 1];
 
-            // Use the version number from Client Hello, overriding the
-            // value we got earlier. Some clients will always set the
-            // version number in the Record Layer to TLS 1.0, even if they
-            // support better protocols.            
-            cfg->protocol_high = *p++;
-            cfg->protocol_low = *p++;
-            
-            p += 32; // random value
-            mylen -= 34;
-            
-            if (mylen < 1) { // for the ID length byte
-                return -4;
-            }
-            
-            idlen = *p;
-            p += 1; // ID len
-            mylen -= 1;
-            
-            if (mylen < (apr_size_t)idlen) { // for the ID
-                return -5;
-            }
-                
-            p += idlen; // ID
-            mylen -= idlen;
-            
-            if (mylen < 2) { // for the CS length bytes
-                return -6;
-            }
-            
-            cslen = (*p * 256) + *(p + 1);
-            cslen = cslen / 2; // each suite consumes 2 bytes
-            
-            p += 2; // Cipher Suites len
-            mylen -= 2;
-            
-            if (mylen < (apr_size_t)cslen * 2) { // for the suites
-                return -7;
-            }
-                
-            // Keep the pointer to where the suites begin. The memory
-            // was allocated from the connection pool, so it should
-            // be around for as long as we need it.
-            cfg->slen = cslen;
-            cfg->suites = (const char *)p;
-            
-            cfg->thandshake = apr_psprintf(f->c->pool, "%d", cfg->hello_version);
-            cfg->tprotocol = apr_psprintf(f->c->pool, "%d.%d", cfg->protocol_high, cfg->protocol_low);
-            
-            // Create a list of suites as text, for logging
-            q = apr_pcalloc(f->c->pool, (cslen * 7) + 1);
-			if (q == NULL) return -1;            
-            cfg->tsuites = (const char *)q;
-            
-            // Extract cipher suites; each suite consists of 2 bytes
-            while (cslen--) {
-                if ((const char *)q != cfg->tsuites) {
-                    *q++ = ',';
-                }
+    while (lo < hi) {
+        apr_uint32_t mid = lo + ((hi - lo) / 2);
+        int c = memcmp(clientdb->clients[mid].digest, digest, SSLHAF_MD5_DIGESTSIZE);
 
-                if (*p != 0) {
-                    c2x(*p, q);
-                    q += 2;
-                }
-                
-                c2x(*(p + 1), q);
-                q += 2;
-                    
-                p += 2;
-            }
-            
-            *q = '\0';
-            mylen -= cfg->slen * 2;
-            
-            // Compression
-            if (mylen < 1) { // compression data length
-                return -8;
-            }
-            
-            int clen = *p++;
-            mylen--;
-            
-            if (mylen < clen) { // compression data
-                return -9;
-            }
-            
-            cfg->compression_len = clen;
-            q = apr_pcalloc(f->c->pool, (clen * 3) + 1);
-			if (q == NULL) return -1;            
-            cfg->compression_methods = (const char *)q;
-            
-            while(clen--) {
-                if ((const char *)q != cfg->compression_methods) {
-                    *q++ = ',';
-                }
-                
-                c2x(*p, q);
-                p++;
-                q += 2;
-            }
-            
-            *q = '\0';
-            mylen -= cfg->compression_len;
-            
-            if (mylen == 0) {
-                // It's OK if there is no more data; that means
-                // we're seeing a handshake without any extensions
-                return 1;
-            }
-            
-            // Extensions
-            if (mylen < 2) { // extensions length
-                return -10;
-            }
-                
-            int elen = (*p * 256) + *(p + 1);
-            
-            mylen -= 2;
-            p += 2;
-            
-            if (mylen < elen) { // extension data
-                return -11;
-            }
-            
-            cfg->extensions_len = 0;
-            q = apr_pcalloc(f->c->pool, (elen * 5) + 1);
-			if (q == NULL) return -1;            
-            cfg->extensions = (const char *)q;
-
-            int ec_point_ext_id = 11;
-            int group_id = 10;
-            while(elen > 0) {
-                cfg->extensions_len++;
-                
-                if ((const char *)q != cfg->extensions) {
-                    *q++ = ',';
-                }
-                
-                // extension type, byte 1                
-                c2x(*p, q);
-                unsigned b1 = *p;
-                p++;
-                elen--;
-                q += 2;
-                
-                // extension type, byte 2
-                c2x(*p, q);
-                unsigned b2 = *p;
-                p++;
-                elen--;
-                q += 2;
-
-                int ext_type = (b1 * 256) + b2;
-                
-                // extension length
-                int ext1len = (*p * 256) + *(p + 1);
-                p += 2;
-                elen -= 2;
-
-                // p += ext1len;
-                // elen -= ext1len;  
-                
-                // skip over extension data if we're not interested in it
-                if (ext_type == group_id) {
-                    int ec_len = (*p * 256) + *(p + 1);
-                    p += 2;
-                    // elen -= 2;
-                    unsigned char *e;
-                    e = apr_pcalloc(f->c->pool, (ec_len * 10) + 1);
-                    cfg->curves = (const char *)e;
-
-                    while (ec_len > 0) {
-                        if ((const char *)e != cfg->curves) {
-                            *e++ = ',';
-                        }
-                        c2x(*p, e);
-                        p++;
-                        ec_len--;
-                        e += 2;
-                        c2x(*p, e);
-                        p++;
-                        ec_len--;
-                        e += 2;
-                    }
-                    *e = '\0';
-                    elen -= ext1len;
-                } else if (ext_type == ec_point_ext_id) {
-                    int curve_len_1 = *p;
-                    p++;
-                    unsigned char *c;
-                    c = apr_pcalloc(f->c->pool, (curve_len_1 * 10) + 1);
-                    cfg->curve_len = curve_len_1;
-                    cfg->ec_point = (const char *)c;
-
-                    while (curve_len_1 > 0) {
-                        if ((const char *)c != cfg->ec_point) {
-                            *c++ = ',';
-                        }
-                        c2x(*p, c);
-                        p++;
-                        curve_len_1--;
-                        c+= 2;
-                    }
-                    *c = '\0';
-                    elen -= ext1len;
-                } else {
-                    p += ext1len;
-                    elen -= ext1len;      
-                }
-            }
-            
-            *q = '\0';
+        if (c == 0) {
+            return &clientdb->clients[mid];
+        } else if (c < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
 
-    log_client_hello(f, cfg);
-    
-    return 1;
+    return NULL;
 }
 
 /**
- * Decode SSLv3+ packet data.
+ * Load the client database. Each line holds a JA3 hash (32 hexadecimal
+ * characters) followed by whitespace and a label; empty lines and lines
+ * starting with # are ignored. The entries are sorted by digest and
+ * indexed by digest prefix, then never modified again.
  */
-static int decode_packet_v3(ap_filter_t *f, sslhaf_cfg_t *cfg) {
-    if (cfg->buf_protocol == PROTOCOL_HANDSHAKE) {
-        return decode_packet_v3_handshake(f, cfg);
-    } else {
-        // Ignore unknown protocols
-        return 1;
+static int clientdb_load(apr_pool_t *pconf, server_rec *s, const char *filename) {
+    apr_array_header_t *clients = apr_array_make(pconf, 256, sizeof(sslhaf_client_t));
+    sslhaf_clientdb_t *db;
+    ap_configfile_t *cf;
+    char line[MAX_STRING_LEN];
+    apr_status_t rv;
+    apr_uint32_t i, p;
+
+    rv = ap_pcfg_openfile(&cf, pconf, filename);
+    if (rv != APR_SUCCESS) {
+        ap_log_error(APLOG_MARK, APLOG_ERR, rv, s,
+            "mod_sslhaf: Failed to open client database %s", filename);
+        return HTTP_INTERNAL_SERVER_ERROR;
     }
-}
 
-/**
- * Deal with a single bucket. We look for a handshake SSL packet, buffer
- * it (possibly across several invocations), then invoke a function to analyse it.
- */
-static int decode_bucket(ap_filter_t *f, sslhaf_cfg_t *cfg,
-    const unsigned char *inputbuf, apr_size_t inputlen)
-{
-    #ifdef ENABLE_DEBUG
-    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, f->c->base_server,
-        "mod_sslhaf [%s]: decode_bucket (inputlen %" APR_SIZE_T_FMT ")", CONN_REMOTE_IP(f->c), inputlen);
-    #endif
-        
-    // Loop while there's input to process
-    while(inputlen > 0) {
-        #ifdef ENABLE_DEBUG
-        ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, f->c->base_server,
-        "mod_sslhaf [%s]: decode_bucket (inputlen %" APR_SIZE_T_FMT ", state %d)", CONN_REMOTE_IP(f->c), inputlen, cfg->state);
-        #endif
-        
-        if (cfg->state == STATE_GOAWAY) {
-            return 1;
+    while (ap_cfg_getline(line, sizeof(line), cf) == APR_SUCCESS) {
+        sslhaf_client_t *client;
+        const char *label;
+
+        // Lines come back with leading and trailing whitespace removed
+        if ((line[0] == '\0')||(line[0] == '#')) {
+            continue;
         }
-        
-        // Are we looking for the next packet of data?
-        if ((cfg->state == STATE_START)||(cfg->state == STATE_READING)) {
-            apr_size_t len;
-
-            // Are we expecting a handshake packet?
-            if (cfg->state == STATE_START) {
-                if ((inputbuf[0] != PROTOCOL_HANDSHAKE)&&(inputbuf[0] != 128)) {
-                    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, f->c->base_server,
-                        "mod_sslhaf: First byte (%d) of this connection does not indicate SSL; skipping", inputbuf[0]);
-                        return -1;
-                }
-            }
 
-            // Check for SSLv3+
-            if (  (inputbuf[0] == PROTOCOL_HANDSHAKE)
-                ||(inputbuf[0] == PROTOCOL_APPLICATION)
-                ||(inputbuf[0] == PROTOCOL_CHANGE_CIPHER_SPEC))
-            {
-                // Remember protocol
-                cfg->buf_protocol = inputbuf[0];
-                
-                // Go over the protocol byte
-                inputbuf++;
-                inputlen--;
-                
-                // Are there enough bytes to begin analysis?            
-                if (inputlen < 4) {
-                    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: Less than 5 bytes from the packet available in this bucket",
-                        CONN_REMOTE_IP(f->c));
-                    return -1;
-                }
-                
-                cfg->hello_version = 3;
-                // Remember the protocol version used, but only if we don't already have it
-                if (cfg->protocol_high == 0) {
-                    cfg->protocol_high = inputbuf[0];
-                    cfg->protocol_low = inputbuf[1];
-                }
-            
-                // Go over the version bytes
-                inputbuf += 2;
-                inputlen -= 2;                
-            
-                // Calculate packet length
-                len = (inputbuf[0] * 256) + inputbuf[1];
-                
-                // Limit what we are willing to accept
-                if ((len <= 0)||(len > BUF_LIMIT)) {
-                    ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: TLS record too long: %" APR_SIZE_T_FMT "; limit %d",
-                        CONN_REMOTE_IP(f->c), len, BUF_LIMIT);
-                    return -1;
-                }
-            
-                // Go over the packet length bytes
-                inputbuf += 2;
-                inputlen -= 2;
-        
-                // Allocate a buffer to hold the entire packet            
-                cfg->buf = malloc(len);
-                if (cfg->buf == NULL) {
-                    ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: Failed to allocate %" APR_SIZE_T_FMT " bytes",
-                        CONN_REMOTE_IP(f->c), len);
-                    return -1;
-                }
+        client = apr_array_push(clients);
 
-                // Go into buffering mode            
-                cfg->state = STATE_BUFFER;
-                cfg->buf_len = 0;
-                cfg->buf_to_go = len;
+        for (i = 0; i < SSLHAF_MD5_DIGESTSIZE * 2; i++) {
+            if (!apr_isxdigit(line[i])) break;
+        }
 
-                #ifdef ENABLE_DEBUG                
-                ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, f->c->base_server,
-                    "mod_sslhaf [%s]: decode_bucket; buffering protocol %d high %d low %d len %" APR_SIZE_T_FMT,
-                    CONN_REMOTE_IP(f->c), cfg->buf_protocol, cfg->protocol_high, cfg->protocol_low, len);
-                #endif
+        // Only look past the digest once it's all there
+        if ((i == SSLHAF_MD5_DIGESTSIZE * 2)&&(apr_isspace(line[i]))) {
+            label = line + i;
+            while (apr_isspace(*label)) {
+                label++;
             }
-            else
-            // Is it a SSLv2 ClientHello?
-            if (inputbuf[0] == 128) { 
-                // Go over packet type            
-                inputbuf++;
-                inputlen--;
-                
-                // Are there enough bytes to begin analysis?            
-                if (inputlen < 4) {
-                    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: Less than 5 bytes from the packet available in this bucket",
-                        CONN_REMOTE_IP(f->c));
-                    return -1;
-                }
-                
-                // Check that it is indeed ClientHello
-                if (inputbuf[1] != 1) {
-                    ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: Not SSLv2 ClientHello (%d)",
-                        CONN_REMOTE_IP(f->c), inputbuf[1]);
-                    return -1;
-                }
-                
-                cfg->hello_version = 2;
-                
-                if ((inputbuf[2] == 0x00)&&(inputbuf[3] == 0x02)) {
-                    // SSL v2 uses 0x0002 for the version number
-                    cfg->protocol_high = inputbuf[3];
-                    cfg->protocol_low = inputbuf[2];
-                } else {
-                    // SSL v3 will use 0x0300, 0x0301, etc.
-                    cfg->protocol_high = inputbuf[2];
-                    cfg->protocol_low = inputbuf[3];
-                }
-                
-                // We've already consumed 3 bytes from the packet
-                len = inputbuf[0] - 3; 
-
-                // Limit what we are willing to accept
-                if ((len <= 0)||(len > BUF_LIMIT)) {
-                    ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: TLS record too long: %" APR_SIZE_T_FMT "; limit %d",
-                        CONN_REMOTE_IP(f->c), len, BUF_LIMIT);
-                    return -1;
-                }
-            
-                // Go over the packet length (1 byte), message
-                // type (1 byte) and version (2 bytes)
-                inputbuf += 4;
-                inputlen -= 4;
-        
-                // Allocate a buffer to hold the entire packet            
-                cfg->buf = malloc(len);
-                if (cfg->buf == NULL) {
-                    ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: Failed to allocate %" APR_SIZE_T_FMT " bytes",
-                        CONN_REMOTE_IP(f->c), len);
-                    return -1;
-                }
+        } else {
+            label = "";
+        }
 
-                // Go into buffering mode            
-                cfg->state = STATE_BUFFER;
-                cfg->buf_len = 0;
-                cfg->buf_to_go = len;
-            }
-            else {
-                // Unknown protocol
-                return -1;
-            }
+        if (*label == '\0') {
+            ap_log_error(APLOG_MARK, APLOG_ERR, 0, s,
+                "mod_sslhaf: Invalid entry on line %d of client database %s",
+                cf->line_number, filename);
+            ap_cfg_closefile(cf);
+            return HTTP_INTERNAL_SERVER_ERROR;
         }
 
-        // Are we buffering?        
-        if (cfg->state == STATE_BUFFER) {
-            // How much data is available?
-            if (cfg->buf_to_go <= inputlen) {
-                int rc;
-                
-                // We have enough data to complete this packet
-                memcpy(cfg->buf + cfg->buf_len, inputbuf, cfg->buf_to_go);
-                cfg->buf_len += cfg->buf_to_go;
-                inputbuf += cfg->buf_to_go;
-                inputlen -= cfg->buf_to_go;
-                cfg->buf_to_go = 0;
-                
-                // Decode the packet now
-                if (cfg->hello_version == 3) {
-                    rc = decode_packet_v3(f, cfg);
-                } else {
-                    rc = decode_packet_v2(f, cfg);
-                }
-                
-                // Free the packet buffer, which we no longer need
-                free(cfg->buf);
-                cfg->buf = NULL;
-                
-                // Stop following this connection; we're only interested in
-                // ClientHello, which is always the first client message.
-                cfg->state = STATE_GOAWAY;
-                
-                if (rc < 0) {
-                    ap_log_error(APLOG_MARK, APLOG_ERR, 0, f->c->base_server,
-                        "mod_sslhaf [%s]: Packet decoding error rc %d (hello %d)",
-                        CONN_REMOTE_IP(f->c), rc, cfg->hello_version);
-                    return -1;
-                }
+        sslhaf_hex_decode(line, SSLHAF_MD5_DIGESTSIZE, client->digest);
+        client->label = apr_pstrdup(pconf, label);
+        client->blocked = 0;
+    }
 
-                return 1;
-            } else {
-                // There's not enough data; copy what we can and
-                // we'll get the rest later
-                memcpy(cfg->buf + cfg->buf_len, inputbuf, inputlen);
-                cfg->buf_len += inputlen;
-                cfg->buf_to_go -= inputlen;
-                inputbuf += inputlen;
-                inputlen = 0;
-            }
+    ap_cfg_closefile(cf);
+
+    db = apr_pcalloc(pconf, sizeof(*db));
+    db->clients = (sslhaf_client_t *)clients->elts;
+    db->count = clients->nelts;
+
+    qsort(db->clients, db->count, sizeof(sslhaf_client_t), clientdb_compare);
+
+    // Aim for about one entry per index slot
+    db->index_bits = 8;
+    while ((db->index_bits < 16)&&((1u << db->index_bits) < db->count)) {
+        db->index_bits++;
+    }
+
+    // index[p] is the first entry whose prefix is p or greater
+    db->index = apr_palloc(pconf, ((1u << db->index_bits) + 1) * sizeof(apr_uint32_t));
+    for (i = 0, p = 0; p <= (1u << db->index_bits); p++) {
+        while ((i < db->count)&&(DIGEST_PREFIX(db->clients[i].digest, db->index_bits) < p)) {
+            i++;
+        }
+
+        db->index[p] = i;
+    }
+
+    clientdb = db;
+
+    ap_log_error(APLOG_MARK, APLOG_INFO, 0, s,
+        "mod_sslhaf: Loaded %u clients from %s", db->count, filename);
+
+    return OK;
+}
+
+/**
+ * Mark the clients with the SSLHAFBlock labels as blocked. This is
+ * done before the children are forked, after which the database is
+ * never modified again. Returns the number of clients blocked.
+ */
+static apr_uint32_t clientdb_block(server_rec *s, const apr_array_header_t *labels) {
+    const char * const *label = (const char * const *)labels->elts;
+    apr_uint32_t blocked = 0, i;
+    int j;
+
+    for (j = 0; j < labels->nelts; j++) {
+        apr_uint32_t found = 0;
+
+        for (i = 0; (clientdb != NULL)&&(i < clientdb->count); i++) {
+            if (strcmp(clientdb->clients[i].label, label[j]) == 0) {
+                clientdb->clients[i].blocked = 1;
+                found++;
+            }
+        }
+
+        if (found == 0) {
+            ap_log_error(APLOG_MARK, APLOG_WARNING, 0, s,
+                "mod_sslhaf: No client in the client database has the label %s", label[j]);
+        }
+
+        blocked += found;
+    }
+
+    return blocked;
+}
+
+/**
+ * Estimate the number of distinct addresses that set the bits of a
+ * bitmap of LOG_ADDR_BITS bits with zero bits left unset, by linear
+ * counting: m ln(m / zero). Once every bit is set, the estimate is
+ * that for one bit left, and a lower bound.
+ */
+static unsigned long log_addr_estimate(unsigned int zero) {
+    if (zero == 0) {
+        zero = 1;
+    }
+
+    return (unsigned long)(LOG_ADDR_BITS * log((double)LOG_ADDR_BITS / zero) + 0.5);
+}
+
+/**
+ * Log, and forget, the summary of the lines left out. Called with the
+ * mutex held; the summary is formatted into buf, to be logged once it
+ * has been released. Returns the level to log it at, or -1 if there's
+ * nothing to log.
+ */
+static int log_summary(sslhaf_log_limit_t *ll, apr_time_t now, char *buf, apr_size_t len) {
+    unsigned long total = 0;
+    apr_size_t used;
+    int level = ll->level;
+    int i, j;
+
+    if (level < 0) {
+        return -1;
+    }
+
+    for (i = 0; i < LOG_REASONS; i++) {
+        total += ll->suppressed[i];
+    }
+
+    used = apr_snprintf(buf, len, "Left out %lu lines in the last %ld s:", total,
+        (long)apr_time_sec(now - ll->since));
+
+    for (i = 0; i < LOG_REASONS; i++) {
+        unsigned int set = 0;
+
+        if (ll->suppressed[i] == 0) {
+            continue;
+        }
+
+        for (j = 0; j < LOG_ADDR_BITS / 8; j++) {
+            unsigned char b = ll->addrs[i][j];
+
+            for (; b != 0; b &= b - 1) {
+                set++;
+            }
+        }
+
+        if (used < len) {
+            used += apr_snprintf(buf + used, len - used, " %lu %s from %s%lu addresses,",
+                ll->suppressed[i], (i >= LOG_HELLO) ? log_reason_names[i - LOG_HELLO]
+                    : (i == 0) ? "other" : sslhaf_failure_names[i],
+                (set == LOG_ADDR_BITS) ? "over " : "", log_addr_estimate(LOG_ADDR_BITS - set));
+        }
+    }
+
+    // No comma after the last reason
+    if (used < len) {
+        buf[used - 1] = '\0';
+    }
+
+    memset(ll->suppressed, 0, sizeof(ll->suppressed));
+    memset(ll->addrs, 0, sizeof(ll->addrs));
+    ll->level = -1;
+
+    return level;
+}
+
+/**
+ * Decide whether to log a line about a connection, for the given
+ * reason (LOG_HELLO or an SSLHAF_E_* value) at the given level. Takes
+ * a token from the bucket if there's one; otherwise counts the line
+ * as left out. Logs the summary of the lines left out when it's due.
+ */
+static int log_allowed(conn_rec *c, int reason, int level) {
+    sslhaf_log_limit_t *ll = log_limit;
+    apr_time_t now;
+    char summary[512];
+    int summary_level = -1;
+    int allowed;
+
+    if (!LOG_LEVEL_ON(c->base_server, level)) {
+        return 0;
+    }
+
+    if (ll == NULL) {
+        return 1;
+    }
+
+    now = apr_time_now();
+
+    #if APR_HAS_THREADS
+    apr_thread_mutex_lock(ll->mutex);
+    #endif
+
+    // A token every 1/LOG_RATE s, up to LOG_BURST
+    if (now > ll->refill) {
+        apr_time_t add = ((now - ll->refill) * LOG_RATE) / APR_USEC_PER_SEC;
+
+        if (ll->tokens + add >= LOG_BURST) {
+            ll->tokens = LOG_BURST;
+            ll->refill = now;
+        } else if (add > 0) {
+            ll->tokens += add;
+            ll->refill += (add * APR_USEC_PER_SEC) / LOG_RATE;
+        }
+    }
+
+    allowed = (ll->tokens > 0);
+
+    if (allowed) {
+        ll->tokens--;
+    } else {
+        const char *ip = CONN_REMOTE_IP(c);
+        apr_uint32_t hash = 2166136261U;
+
+        // FNV-1a of the address picks its bit
+        for (; (ip != NULL)&&(*ip != '\0'); ip++) {
+            hash = (hash ^ (unsigned char)*ip) * 16777619U;
+        }
+
+        hash %= LOG_ADDR_BITS;
+
+        if (ll->level < 0) {
+            ll->since = now;
+            ll->level = level;
+        } else if (level < ll->level) {
+            ll->level = level;
+        }
+
+        ll->suppressed[reason]++;
+        ll->addrs[reason][hash / 8] |= 1 << (hash % 8);
+    }
+
+    if ((ll->level >= 0)&&(now - ll->since >= LOG_SUMMARY_INTERVAL)) {
+        summary_level = log_summary(ll, now, summary, sizeof(summary));
+    }
+
+    #if APR_HAS_THREADS
+    apr_thread_mutex_unlock(ll->mutex);
+    #endif
+
+    if (summary_level >= 0) {
+        ap_log_error(APLOG_MARK, summary_level, 0, c->base_server, "mod_sslhaf: %s", summary);
+    }
+
+    return allowed;
+}
+
+/**
+ * Log the summary of the lines left out when the child exits.
+ */
+static apr_status_t log_limit_stop(void *data) {
+    sslhaf_log_limit_t *ll = data;
+    char summary[512];
+    int level;
+
+    log_limit = NULL;
+
+    level = log_summary(ll, apr_time_now(), summary, sizeof(summary));
+    if (level >= 0) {
+        ap_log_error(APLOG_MARK, level, 0, NULL, "mod_sslhaf: %s", summary);
+    }
+
+    return APR_SUCCESS;
+}
+
+/**
+ * Logs the current Client Hello to the error log.
+ */
+static void log_client_hello(conn_rec *c, const sslhaf_t *hello) {
+    if (!log_allowed(c, LOG_HELLO, APLOG_INFO)) {
+        return;
+    }
+
+    ap_log_error(APLOG_MARK, APLOG_INFO, 0, c->base_server,
+        "mod_sslhaf [%s]: Client Hello: handshake %d, protocol %d.%d, extensions %" APR_SIZE_T_FMT,
+        CONN_REMOTE_IP(c), hello->hello_version, hello->protocol_high, hello->protocol_low,
+        hello->extensions_len);
+}
+
+/**
+ * Queue a record of the current Client Hello for the binary log. The
+ * record is written straight into the ring, as it outlives the
+ * connection, so nothing is allocated for it.
+ */
+static void binlog_append(conn_rec *c, const sslhaf_t *hello) {
+    apr_sockaddr_t *addr = CONN_REMOTE_ADDR(c);
+    apr_uint64_t now = apr_time_now();
+    unsigned char *record;
+    apr_size_t len = BINLOG_HEADER_LEN + hello->raw_len;
+    apr_uint32_t need = APR_ALIGN(BINLOG_ENTRY_HEADER + len, BINLOG_ALIGN);
+    apr_uint32_t pos, off, pad;
+    apr_uint32_t *entry;
+    int i;
+
+    // Reserve room for the entry, and, if it would run past the end
+    // of the ring, for skipping to the start
+    for (;;) {
+        pos = apr_atomic_read32(&binlog->head);
+        off = pos % BINLOG_RING;
+        pad = (off + need > BINLOG_RING) ? BINLOG_RING - off : 0;
+
+        if (pos + pad + need - apr_atomic_read32(&binlog->tail) > BINLOG_RING) {
+            apr_atomic_inc32(&binlog->dropped);
+            return;
+        }
+
+        if (apr_atomic_cas32(&binlog->head, pos + pad + need, pos) == pos) {
+            break;
+        }
+    }
+
+    if (pad > 0) {
+        apr_atomic_xchg32((apr_uint32_t *)(binlog->ring + off), pad | BINLOG_PAD);
+        off = 0;
+    }
+
+    entry = (apr_uint32_t *)(binlog->ring + off);
+    record = binlog->ring + off + BINLOG_ENTRY_HEADER;
+
+    memset(record, 0, BINLOG_HEADER_LEN);
+    record[0] = len >> 24;
+    record[1] = len >> 16;
+    record[2] = len >> 8;
+    record[3] = len;
+    record[5] = BINLOG_FORMAT;
+    record[7] = hello->hello_version;
+
+    for (i = 0; i < 8; i++) {
+        record[8 + i] = now >> (56 - (i * 8));
+    }
+
+    if (addr != NULL) {
+        #if APR_HAVE_IPV6
+        if (addr->family == APR_INET6) {
+            record[6] = 6;
+        } else
+        #endif
+        {
+            record[6] = 4;
+        }
+
+        memcpy(record + 16, addr->ipaddr_ptr, (addr->ipaddr_len < 16) ? addr->ipaddr_len : 16);
+    }
+
+    memcpy(record + 32, hello->ja3_digest, SSLHAF_MD5_DIGESTSIZE);
+    memcpy(record + BINLOG_HEADER_LEN, hello->raw, hello->raw_len);
+
+    // Fill the entry in, then hand it over
+    entry[1] = len;
+    apr_atomic_xchg32(&entry[0], need);
+}
+
+#if APR_HAVE_SYS_UN_H
+/**
+ * Send a batch of records to the collector, if it can take it right
+ * away. Otherwise, count the records as dropped.
+ */
+static void export_send(sslhaf_binlog_t *bl, const unsigned char *data, apr_size_t len,
+    unsigned int records)
+{
+    if (bl->sock < 0) {
+        struct sockaddr_un addr;
+        apr_time_t now = apr_time_now();
+        int size = EXPORT_SNDBUF;
+
+        if (now < bl->retry) {
+            bl->export_dropped += records;
+            return;
+        }
+
+        bl->retry = now + EXPORT_RETRY;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        apr_cpystrn(addr.sun_path, bl->export_path, sizeof(addr.sun_path));
+
+        bl->sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (bl->sock < 0) {
+            bl->export_dropped += records;
+            return;
+        }
+
+        // Big enough for the largest record, where datagrams are
+        // limited by the buffer size; not fatal if it fails
+        setsockopt(bl->sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+        if ((fcntl(bl->sock, F_SETFL, fcntl(bl->sock, F_GETFL) | O_NONBLOCK) < 0)
+            ||(connect(bl->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0))
+        {
+            close(bl->sock);
+            bl->sock = -1;
+            bl->export_dropped += records;
+            return;
+        }
+    }
+
+    if (send(bl->sock, data, len, 0) < 0) {
+        bl->export_dropped += records;
+
+        // The collector is busy, or it's gone; in the latter case, a
+        // new one may be listening at the same path later
+        if ((errno != EAGAIN)&&(errno != EWOULDBLOCK)&&(errno != ENOBUFS)) {
+            close(bl->sock);
+            bl->sock = -1;
+        }
+    }
+}
+#endif
+
+/**
+ * Write a batch of records wherever they go.
+ */
+static void binlog_write(sslhaf_binlog_t *bl, const unsigned char *data, apr_size_t len,
+    unsigned int records)
+{
+    if (bl->file != NULL) {
+        apr_status_t rv = apr_file_write_full(bl->file, data, len, NULL);
+        if (rv != APR_SUCCESS) {
+            ap_log_error(APLOG_MARK, APLOG_ERR, rv, NULL,
+                "mod_sslhaf: Failed to write to the binary log");
+        }
+    }
+
+    #if APR_HAVE_SYS_UN_H
+    if (bl->export_path != NULL) {
+        export_send(bl, data, len, records);
+    }
+    #endif
+}
+
+/**
+ * Write out the records queued so far, in as few writes as possible.
+ * Only one thread may do this.
+ */
+static void binlog_flush(sslhaf_binlog_t *bl) {
+    apr_size_t batch_len = 0;
+    unsigned int batch_records = 0;
+
+    for (;;) {
+        unsigned char *data = bl->ring + (bl->tail % BINLOG_RING);
+        apr_uint32_t size = apr_atomic_read32((apr_uint32_t *)data);
+        apr_uint32_t len;
+
+        // Zeroed, so not filled in yet, or past the head
+        if (size == 0) {
+            break;
+        }
+
+        if (!(size & BINLOG_PAD)) {
+            len = ((apr_uint32_t *)data)[1];
+
+            if ((batch_len > 0)&&(batch_len + len > BINLOG_BATCH)) {
+                binlog_write(bl, bl->batch, batch_len, batch_records);
+                batch_len = 0;
+                batch_records = 0;
+            }
+
+            // A record that doesn't fit a batch goes out on its own
+            if (len > BINLOG_BATCH) {
+                binlog_write(bl, data + BINLOG_ENTRY_HEADER, len, 1);
+            } else {
+                memcpy(bl->batch + batch_len, data + BINLOG_ENTRY_HEADER, len);
+                batch_len += len;
+                batch_records++;
+            }
+        }
+
+        // The space is free for the producers again
+        size &= ~BINLOG_PAD;
+        memset(data, 0, size);
+        apr_atomic_xchg32(&bl->tail, bl->tail + size);
+    }
+
+    if (batch_len > 0) {
+        binlog_write(bl, bl->batch, batch_len, batch_records);
+    }
+}
+
+#if APR_HAS_THREADS
+/**
+ * The flusher thread of a child.
+ */
+static void * APR_THREAD_FUNC binlog_thread(apr_thread_t *thd, void *data) {
+    sslhaf_binlog_t *bl = data;
+
+    while (!apr_atomic_read32(&bl->stop)) {
+        apr_sleep(BINLOG_INTERVAL);
+        binlog_flush(bl);
+    }
+
+    apr_thread_exit(thd, APR_SUCCESS);
+
+    return NULL;
+}
+#endif
+
+/**
+ * Stop the flusher when the child exits, writing out what's left.
+ */
+static apr_status_t binlog_stop(void *data) {
+    sslhaf_binlog_t *bl = data;
+    apr_uint32_t dropped;
+
+    #if APR_HAS_THREADS
+    if (bl->thread != NULL) {
+        apr_status_t rv;
+
+        apr_atomic_set32(&bl->stop, 1);
+        apr_thread_join(&rv, bl->thread);
+    }
+    #endif
+
+    binlog_flush(bl);
+
+    dropped = apr_atomic_read32(&bl->dropped);
+    if (dropped != 0) {
+        ap_log_error(APLOG_MARK, APLOG_WARNING, 0, NULL,
+            "mod_sslhaf: %u binary log records were dropped", dropped);
+    }
+
+    #if APR_HAVE_SYS_UN_H
+    if (bl->export_dropped != 0) {
+        ap_log_error(APLOG_MARK, APLOG_WARNING, 0, NULL,
+            "mod_sslhaf: %u records were not exported to %s", bl->export_dropped,
+            bl->export_path);
+    }
+
+    if (bl->sock >= 0) {
+        close(bl->sock);
+        bl->sock = -1;
+    }
+    #endif
+
+    binlog = NULL;
+
+    return APR_SUCCESS;
+}
+
+/**
+ * Count a bucket the parser has been given, and, if the parser is
+ * done with the connection, how it ended.
+ */
+static void stats_update(sslhaf_cfg_t *cfg, int rc, apr_size_t len, apr_uint64_t elapsed) {
+    const sslhaf_t *h = &cfg->hello;
+
+    STATS_ADD(stats->bytes, len);
+    STATS_ADD(stats->buckets, 1);
+    STATS_ADD(stats->parse_time, elapsed);
+
+    if (rc == SSLHAF_AGAIN) {
+        // A record continues in the next bucket if we're in the
+        // middle of its header or its data
+        if (((h->state == SSLHAF_STATE_HEADER)&&(h->header_len > 0))
+            ||(h->state == SSLHAF_STATE_PARSING))
+        {
+            unsigned int record = h->hello_records + (h->state == SSLHAF_STATE_HEADER);
+
+            if (record != cfg->spanning_record) {
+                cfg->spanning_record = record;
+                STATS_ADD(stats->spanning, 1);
+            }
+        }
+
+        return;
+    }
+
+    if (h->done) {
+        STATS_ADD(stats->fingerprinted, 1);
+    } else if ((h->error_code > 0)&&(h->error_code <= SSLHAF_E_MAX)) {
+        STATS_ADD(stats->failed[h->error_code], 1);
+    } else {
+        STATS_ADD(stats->no_hello, 1);
+    }
+
+    if ((h->decode_rc < 0)&&(h->decode_rc >= -SSLHAF_DECODE_CODES)) {
+        STATS_ADD(stats->decode_rc[-h->decode_rc], 1);
+    }
+}
+
+/**
+ * We're done with the connection: remove the filter, and, unless the
+ * ClientHello was fingerprinted, the connection's state, which is all
+ * that sslhaf_post_request() looks at.
+ */
+static void sslhaf_filter_done(ap_filter_t *f, sslhaf_cfg_t *cfg) {
+    ap_remove_input_filter(f);
+
+    if (!cfg->hello.done) {
+        ap_set_module_config(f->c->conn_config, &sslhaf_module, NULL);
+    }
+}
+
+/**
+ * Allocate memory for the parser from the connection pool.
+ */
+static void *sslhaf_pool_alloc(void *ctx, size_t size) {
+    return apr_palloc((apr_pool_t *)ctx, size);
+}
+
+/**
+ * Deal with a single bucket, handing it to the parser. Once the
+ * ClientHello has been fingerprinted, count it in the fingerprint
+ * table and look the client up, and, if we're shedding connections,
+ * decide whether to turn this one away.
+ */
+static int decode_bucket(conn_rec *c, sslhaf_cfg_t *cfg,
+    const unsigned char *inputbuf, apr_size_t inputlen)
+{
+    apr_uint64_t start = 0;
+    int rc;
+
+    #ifdef ENABLE_DEBUG
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, c->base_server,
+        "mod_sslhaf [%s]: decode_bucket (inputlen %" APR_SIZE_T_FMT ", state %d)",
+        CONN_REMOTE_IP(c), inputlen, cfg->hello.state);
+    #endif
+
+    if (stats != NULL) {
+        start = STATS_CLOCK();
+    }
+
+    rc = sslhaf_feed(&cfg->hello, inputbuf, inputlen);
+
+    if (stats != NULL) {
+        stats_update(cfg, rc, inputlen, STATS_CLOCK() - start);
+    }
+
+    if (rc == SSLHAF_NOT_SSL) {
+        if (log_allowed(c, cfg->hello.error_code, APLOG_DEBUG)) {
+            ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, c->base_server,
+                "mod_sslhaf [%s]: %s", CONN_REMOTE_IP(c), cfg->hello.error);
+        }
+    } else if (rc == SSLHAF_ERROR) {
+        if (log_allowed(c, cfg->hello.error_code, APLOG_ERR)) {
+            ap_log_error(APLOG_MARK, APLOG_ERR, 0, c->base_server,
+                "mod_sslhaf [%s]: %s", CONN_REMOTE_IP(c), cfg->hello.error);
+        }
+    } else if ((rc == SSLHAF_DONE)&&(cfg->hello.done)) {
+        // The fingerprint table and the client database are keyed by JA3
+        if ((cfg->outputs & SSLHAF_OUTPUT_JA3)||(cfg->shedding)) {
+            sslhaf_fp_entry_t *entry = fptable_update(&cfg->hello);
+            const sslhaf_client_t *client = clientdb_lookup(cfg->hello.ja3_digest);
+
+            sketch_update(cfg->hello.ja3_digest);
+
+            if ((client != NULL)&&(cfg->outputs & SSLHAF_OUTPUT_JA3)) {
+                cfg->client_label = client->label;
+            }
+
+            // When the table is full, the connection goes through
+            if (cfg->shedding) {
+                if ((client != NULL)&&(client->blocked)) {
+                    cfg->shed = SHED_BLOCKED;
+                } else if ((shed_interval != 0)&&(entry != NULL)&&(!fptable_conforms(entry))) {
+                    cfg->shed = SHED_RATE_LIMITED;
+                }
+            }
+        }
+
+        if (binlog != NULL) {
+            binlog_append(c, &cfg->hello);
+
+            #if !APR_HAS_THREADS
+            binlog_flush(binlog);
+            #endif
+        }
+
+        log_client_hello(c, &cfg->hello);
+    }
+
+    return rc;
+}
+
+/**
+ * Turn the connection away, before mod_ssl has seen any of it: count
+ * and log it, then drop what was read and tell mod_ssl the connection
+ * is gone. Nothing waits here, so that a flood of such connections
+ * can't tie up the server's threads.
+ */
+static apr_status_t sslhaf_shed(ap_filter_t *f, apr_bucket_brigade *bb, sslhaf_cfg_t *cfg) {
+    conn_rec *c = f->c;
+    int reason = (cfg->shed == SHED_BLOCKED) ? LOG_BLOCKED : LOG_RATE_LIMITED;
+
+    if (stats != NULL) {
+        if (cfg->shed == SHED_BLOCKED) {
+            STATS_ADD(stats->blocked, 1);
+        } else {
+            STATS_ADD(stats->rate_limited, 1);
+        }
+    }
+
+    if (log_allowed(c, reason, APLOG_INFO)) {
+        ap_log_error(APLOG_MARK, APLOG_INFO, 0, c->base_server,
+            "mod_sslhaf [%s]: Turning away connection (%s): JA3 %s",
+            CONN_REMOTE_IP(c), log_reason_names[reason - LOG_HELLO], cfg->hello.ja3_hash);
+    }
+
+    apr_brigade_cleanup(bb);
+    c->aborted = 1;
+
+    sslhaf_filter_done(f, cfg);
+
+    return APR_ECONNABORTED;
+}
+
+/**
+ * This input filter will basicall sniff on a connection and analyse
+ * the packets when it detects SSL. Once the ClientHello has been
+ * fingerprinted, or ruled out, the filter takes itself out of the
+ * connection, so that it costs nothing for the rest of it. If there's
+ * no fingerprint, the connection's state goes too.
+ */
+static apr_status_t sslhaf_in_filter(ap_filter_t *f,
+                                    apr_bucket_brigade *bb,
+                                    ap_input_mode_t mode,
+                                    apr_read_type_e block,
+                                    apr_off_t readbytes)
+{
+    sslhaf_cfg_t *cfg = ap_get_module_config(f->c->conn_config, &sslhaf_module);
+    apr_status_t status;
+    apr_bucket *bucket;
+    
+    // Return straight away if there's no configuration
+    if (cfg == NULL) {
+        ap_remove_input_filter(f);
+        return ap_get_brigade(f->next, bb, mode, block, readbytes);
+    }
+    
+    // Get the brigade
+    status = ap_get_brigade(f->next, bb, mode, block, readbytes);
+    if (status != APR_SUCCESS) {
+        cfg->hello.state = SSLHAF_STATE_GOAWAY;
+        sslhaf_filter_done(f, cfg);
+        return status;
+    }
+
+    // Loop through the buckets
+    for(bucket = APR_BRIGADE_FIRST(bb);
+        bucket != APR_BRIGADE_SENTINEL(bb);
+        bucket = APR_BUCKET_NEXT(bucket))
+    {
+        const char *buf = NULL;
+        apr_size_t buflen = 0;
+        
+        if (!(APR_BUCKET_IS_METADATA(bucket))) {
+            // Get bucket data
+            status = apr_bucket_read(bucket, &buf, &buflen, APR_BLOCK_READ);
+            if (status != APR_SUCCESS) {
+                ap_log_error(APLOG_MARK, APLOG_ERR, status, f->c->base_server,
+                    "mod_sslhaf [%s]: Error while reading input bucket",
+                    CONN_REMOTE_IP(f->c));
+                cfg->hello.state = SSLHAF_STATE_GOAWAY;
+                sslhaf_filter_done(f, cfg);
+                return status;
+            }
+            
+            // Look into the bucket; if there's no more
+            // work left to be done, break away
+            if (decode_bucket(f->c, cfg, (const unsigned char *)buf, buflen) != SSLHAF_AGAIN) {
+                if (cfg->shed) {
+                    return sslhaf_shed(f, bb, cfg);
+                }
+
+                sslhaf_filter_done(f, cfg);
+                return APR_SUCCESS;
+            }
+        }
+    }
+    
+    return APR_SUCCESS;
+}
+
+#ifdef SSLHAF_WITH_OPENSSL
+/**
+ * OpenSSL's message callback, for SSLHAFBackend openssl. The ClientHello
+ * arrives as one handshake message, however many records it took, and
+ * is given to the parser as a single record, so there's nothing for us
+ * to buffer. mod_ssl makes the connection the SSL's app data.
+ */
+static void sslhaf_msg_callback(int write_p, int version, int content_type,
+    const void *buf, size_t len, SSL *ssl, void *arg)
+{
+    const unsigned char *msg = buf;
+    unsigned char header[5];
+    size_t header_len = 0;
+    sslhaf_cfg_t *cfg;
+    conn_rec *c;
+    int rc;
+
+    if (write_p) {
+        return;
+    }
+
+    c = SSL_get_app_data(ssl);
+    if (c == NULL) {
+        return;
+    }
+
+    // Only the first ClientHello counts
+    cfg = ap_get_module_config(c->conn_config, &sslhaf_module);
+    if ((cfg == NULL)||(cfg->hello.state != SSLHAF_STATE_START)) {
+        return;
+    }
+
+    #ifdef SSL3_RT_HEADER
+    if (content_type == SSL3_RT_HEADER) {
+        // The protocol version the client put in its first record
+        if ((len == 5)&&(cfg->record_version[0] == 0)) {
+            cfg->record_version[0] = msg[1];
+            cfg->record_version[1] = msg[2];
+        }
+
+        return;
+    }
+    #endif
+
+    if ((content_type == SSL3_RT_HANDSHAKE)&&(len >= 4)&&(msg[0] == SSL3_MT_CLIENT_HELLO)) {
+        header_len = sslhaf_message_header(3,
+            (cfg->record_version[0] != 0) ? cfg->record_version : NULL, len, header);
+    } else if ((version == SSL2_VERSION)&&(content_type == 0)) {
+        // An SSLv2 ClientHello, without its 2-byte record header
+        header_len = sslhaf_message_header(2, NULL, len, header);
+    }
+
+    if (header_len == 0) {
+        return;
+    }
+
+    rc = sslhaf_feed(&cfg->hello, header, header_len);
+
+    if (rc == SSLHAF_AGAIN) {
+        rc = decode_bucket(c, cfg, msg, len);
+    }
+
+    if ((rc != SSLHAF_AGAIN)&&(!cfg->hello.done)) {
+        ap_set_module_config(c->conn_config, &sslhaf_module, NULL);
+    }
+}
+
+/**
+ * Have OpenSSL call us with the ClientHello on the connections to
+ * servers that use SSLHAFBackend openssl. Called by mod_ssl for every
+ * SSL context it sets up. mod_ssl doesn't use the message callback
+ * itself; it does use the ClientHello callback, for SNI.
+ */
+static int sslhaf_ssl_init_server(server_rec *s, apr_pool_t *p, int is_proxy, SSL_CTX *ctx) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(s->module_config, &sslhaf_module);
+
+    if ((!is_proxy)&&(scfg->enable != 0)&&(scfg->backend == SSLHAF_BACKEND_OPENSSL)) {
+        SSL_CTX_set_msg_callback(ctx, sslhaf_msg_callback);
+    }
+
+    return OK;
+}
+#endif
+
+/**
+ * Attach our filter to every incoming SSL connection, unless the
+ * module is disabled for the server it arrived to. This runs after
+ * mod_ssl has set the connection up, so that it can tell; without
+ * mod_ssl, every connection is looked at. The secondary connections
+ * of HTTP/2 carry no handshake of their own.
+ */
+static int sslhaf_pre_conn(conn_rec *c, void *csd) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(c->base_server->module_config, &sslhaf_module);
+    sslhaf_cfg_t *cfg = NULL;
+    unsigned int outputs;
+
+    // HTTP/2 streams use the master connection's fingerprint
+    if ((scfg->enable == 0)||(CONN_MASTER(c) != NULL)) {
+        return OK;
+    }
+
+    if ((sslhaf_is_https != NULL)&&(!sslhaf_is_https(c))) {
+        return OK;
+    }
+    
+    cfg = apr_pcalloc(c->pool, sizeof(*cfg));
+    if (cfg == NULL) return OK;
+
+    cfg->outputs = (scfg->outputs != -1) ? scfg->outputs : SSLHAF_OUTPUT_ALL;
+    outputs = cfg->outputs;
+
+    // The binary log has the packet and the JA3 digest in every record
+    if (binlog != NULL) {
+        outputs |= SSLHAF_OUTPUT_PACKET | SSLHAF_OUTPUT_JA3;
+    }
+
+    // Only the filter sees the ClientHello before the handshake is done
+    if (((shed_blocking)||(shed_interval != 0))&&(scfg->backend != SSLHAF_BACKEND_OPENSSL)) {
+        cfg->shedding = 1;
+        outputs |= SSLHAF_OUTPUT_JA3;
+    }
+
+    sslhaf_init(&cfg->hello, outputs, scfg->max_record, sslhaf_pool_alloc, c->pool);
+    
+    ap_set_module_config(c->conn_config, &sslhaf_module, cfg);
+
+    // With the OpenSSL backend, the message callback does the work
+    if (scfg->backend != SSLHAF_BACKEND_OPENSSL) {
+        ap_add_input_filter(sslhaf_in_filter_name, NULL, NULL, c);
+    }
+
+    if (stats != NULL) {
+        STATS_ADD(stats->connections, 1);
+    }
+
+    #ifdef ENABLE_DEBUG    
+    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, c->base_server,
+        "mod_sslhaf: Connection from %s", c->remote_ip);
+    #endif
+
+    return OK;
+}
+
+/**
+ * Take the textual representation of the client's cipher suite
+ * list and attach it to the request. HTTP/2 requests get it from
+ * the master connection, where it was worked out once for all the
+ * streams; the strings are shared, not copied.
+ */
+static int sslhaf_post_request(request_rec *r) {
+    conn_rec *c = (CONN_MASTER(r->connection) != NULL) ? CONN_MASTER(r->connection) : r->connection;
+    sslhaf_cfg_t *cfg = ap_get_module_config(c->conn_config, &sslhaf_module);
+    
+    // Only connections with a fingerprint have any state by now
+    if ((cfg != NULL)&&(cfg->hello.done)) {
+        const sslhaf_t *hello = &cfg->hello;
+        unsigned int outputs = cfg->outputs;
+
+        // Make the handshake information available to other modules
+        apr_table_setn(r->subprocess_env, "SSLHAF_HANDSHAKE", hello->thandshake);
+        apr_table_setn(r->subprocess_env, "SSLHAF_PROTOCOL", hello->tja3_protocol);
+
+        if (outputs & SSLHAF_OUTPUT_SUITES) {
+            apr_table_setn(r->subprocess_env, "SSLHAF_SUITES", hello->tja3_suites);
+
+            // The weakest key on offer, from suites.csv
+            if (hello->tsuite_min_bits[0] != '\0') {
+                apr_table_setn(r->subprocess_env, "SSLHAF_MIN_KEY_SIZE", hello->tsuite_min_bits);
+            }
+        }
+
+        // The flags, all together and one by one
+        apr_table_setn(r->subprocess_env, "SSLHAF_FLAGS", hello->tflags);
+
+        if (hello->flags != 0) {
+            int i;
+
+            for (i = 0; sslhaf_flag_vars[i].name != NULL; i++) {
+                if (hello->flags & sslhaf_flag_vars[i].flag) {
+                    apr_table_setn(r->subprocess_env, sslhaf_flag_vars[i].name, "1");
+                }
+            }
+        }
+
+        // Expose compression methods
+        if (outputs & SSLHAF_OUTPUT_COMPRESSION) {
+            apr_table_setn(r->subprocess_env, "SSLHAF_COMPRESSION", hello->compression_methods);
+        }
+        
+        // Expose extension data
+        if (outputs & SSLHAF_OUTPUT_EXTENSIONS) {
+            apr_table_setn(r->subprocess_env, "SSLHAF_EXTENSIONS_LEN", hello->textensions_len);
+            apr_table_setn(r->subprocess_env, "SSLHAF_EXTENSIONS", hello->tja3_extensions);
+        }
+
+        // Expose ec_point_format and curves
+        if (outputs & SSLHAF_OUTPUT_CURVES) {
+            apr_table_setn(r->subprocess_env, "EC_POINT", hello->tja3_ec_point);
+            apr_table_setn(r->subprocess_env, "CURVES", hello->tja3_curves);
+        }
+
+        // Help to log only once per connection, keeping
+        // track of how many requests there were
+        if (apr_atomic_inc32(&cfg->request_counter) == 0) {
+            apr_table_setn(r->subprocess_env, "SSLHAF_LOG", "1");
+        }
+
+        if (outputs & SSLHAF_OUTPUT_JA3) {
+            apr_table_setn(r->subprocess_env, "JA3_HASH", hello->ja3_hash);
+        }
+
+        if ((outputs & SSLHAF_OUTPUT_JA4)&&(hello->ja4[0] != '\0')) {
+            apr_table_setn(r->subprocess_env, "JA4_HASH", hello->ja4);
+        }
+
+        // Known client
+        if (cfg->client_label != NULL) {
+            apr_table_setn(r->subprocess_env, "SSLHAF_CLIENT", cfg->client_label);
+        }
+        
+        #if 0
+        // Generate a sha1 of the remote address on the first request
+        if (cfg->ipaddress_hash == NULL) {
+            cfg->ipaddress_hash = generate_sha1(r->connection->pool,
+                r->connection->remote_ip, strlen(r->connection->remote_ip));
+        }
+        
+        apr_table_setn(r->subprocess_env, "SSLHAF_IP_HASH", cfg->ipaddress_hash);
+        #endif
+        
+        // Raw ClientHello
+        if (outputs & SSLHAF_OUTPUT_RAW) {
+            if (hello->client_hello != NULL) {
+                apr_table_setn(r->subprocess_env, "SSLHAF_RAW", hello->client_hello);
+            } else {
+                apr_table_setn(r->subprocess_env, "SSLHAF_RAW", "-");
+            }
+        }
+    }
+    
+    return DECLINED;
+}
+
+/**
+ * Open the binary log for appending, writing the magic number if
+ * the file is new.
+ */
+static int binlog_open(apr_pool_t *pconf, server_rec *s, const char *filename) {
+    apr_finfo_t finfo;
+    apr_status_t rv;
+
+    rv = apr_file_open(&binlog_file, filename, APR_WRITE | APR_CREATE | APR_APPEND | APR_BINARY,
+        APR_OS_DEFAULT, pconf);
+    if (rv != APR_SUCCESS) {
+        ap_log_error(APLOG_MARK, APLOG_ERR, rv, s,
+            "mod_sslhaf: Failed to open binary log %s", filename);
+        binlog_file = NULL;
+        return HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    rv = apr_file_info_get(&finfo, APR_FINFO_SIZE, binlog_file);
+    if ((rv == APR_SUCCESS)&&(finfo.size == 0)) {
+        rv = apr_file_write_full(binlog_file, BINLOG_MAGIC, strlen(BINLOG_MAGIC), NULL);
+    }
+
+    if (rv != APR_SUCCESS) {
+        ap_log_error(APLOG_MARK, APLOG_ERR, rv, s,
+            "mod_sslhaf: Failed to write to binary log %s", filename);
+        binlog_file = NULL;
+        return HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    return OK;
+}
+
+/**
+ * Create a shared memory segment of the given size. Anonymous shared
+ * memory is preferred; where the platform doesn't support it, a named
+ * segment is used. Returns NULL on error.
+ */
+static void *shm_create(apr_pool_t *pconf, server_rec *s, apr_size_t size,
+    const char *name, const char *what)
+{
+    apr_shm_t *shm = NULL;
+    apr_status_t rv;
+
+    rv = apr_shm_create(&shm, size, NULL, pconf);
+    if (APR_STATUS_IS_ENOTIMPL(rv)) {
+        const char *fname = ap_runtime_dir_relative(pconf, name);
+
+        apr_shm_remove(fname, pconf);
+        rv = apr_shm_create(&shm, size, fname, pconf);
+    }
+
+    if (rv != APR_SUCCESS) {
+        ap_log_error(APLOG_MARK, APLOG_ERR, rv, s,
+            "mod_sslhaf: Failed to create the %s; continuing without it", what);
+        return NULL;
+    }
+
+    memset(apr_shm_baseaddr_get(shm), 0, size);
+
+    return apr_shm_baseaddr_get(shm);
+}
+
+/**
+ * Create the counters, with a set for each server process the MPM may
+ * run at once, up to STATS_SLOTS_MAX.
+ */
+static void stats_create(apr_pool_t *pconf, server_rec *s) {
+    apr_size_t slot_size = APR_ALIGN(sizeof(sslhaf_stats_t), STATS_SLOT_ALIGN);
+    int slots = 0;
+
+    if ((ap_mpm_query(AP_MPMQ_HARD_LIMIT_DAEMONS, &slots) != APR_SUCCESS)||(slots < 1)) {
+        slots = 1;
+    } else if (slots > STATS_SLOTS_MAX) {
+        slots = STATS_SLOTS_MAX;
+    }
+
+    stats_table = shm_create(pconf, s, APR_ALIGN(sizeof(sslhaf_stats_table_t), STATS_SLOT_ALIGN)
+        + (slots * slot_size), "sslhaf_stats.shm", "counters");
+    if (stats_table != NULL) {
+        stats_table->slots = slots;
+        stats_table->slot_size = slot_size;
+    }
+}
+
+/**
+ * Load the client database, mark the blocked clients, and create the
+ * fingerprint table, the sketch and the counters in shared memory. The
+ * children inherit the mappings, so every process updates the same ones.
+ */
+static int sslhaf_post_config(apr_pool_t *pconf, apr_pool_t *plog,
+    apr_pool_t *ptemp, server_rec *s)
+{
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(s->module_config, &sslhaf_module);
+
+    // Not there unless mod_ssl is loaded
+    sslhaf_is_https = APR_RETRIEVE_OPTIONAL_FN(ssl_is_https);
+
+    // The client database is loaded before the children are forked,
+    // so they all share one read-only copy
+    clientdb = NULL;
+    if (scfg->clientdb_file != NULL) {
+        int rc = clientdb_load(pconf, s, scfg->clientdb_file);
+        if (rc != OK) {
+            return rc;
+        }
+    }
+
+    // Opened here, while we can still create the file wherever
+    // the configuration says, and written to by the children
+    binlog_file = NULL;
+    if (scfg->binlog_file != NULL) {
+        int rc = binlog_open(pconf, s, scfg->binlog_file);
+        if (rc != OK) {
+            return rc;
+        }
+    }
+
+    // The collector needn't be running yet
+    export_path = scfg->export_socket;
+
+    shed_blocking = 0;
+    if (scfg->block != NULL) {
+        shed_blocking = (clientdb_block(s, scfg->block) > 0);
+    }
+
+    shed_interval = 0;
+    shed_tolerance = 0;
+    if (scfg->rate > 0) {
+        shed_interval = (apr_uint64_t)(APR_USEC_PER_SEC / scfg->rate);
+        if (shed_interval == 0) {
+            shed_interval = 1;
+        }
+
+        shed_tolerance = shed_interval * (scfg->burst - 1);
+    }
+
+    fptable = shm_create(pconf, s, sizeof(sslhaf_fp_table_t), "sslhaf.shm",
+        "fingerprint table");
+
+    sketch = shm_create(pconf, s, sizeof(sslhaf_sketch_t), "sslhaf_sketch.shm",
+        "fingerprint sketch");
+
+    stats_create(pconf, s);
+
+    return OK;
+}
+
+/**
+ * Set up the rate limiting of this child's error log lines.
+ */
+static void log_limit_init(apr_pool_t *pchild, server_rec *s) {
+    sslhaf_log_limit_t *ll = apr_pcalloc(pchild, sizeof(sslhaf_log_limit_t));
+
+    #if APR_HAS_THREADS
+    {
+        apr_status_t rv = apr_thread_mutex_create(&ll->mutex, APR_THREAD_MUTEX_DEFAULT, pchild);
+        if (rv != APR_SUCCESS) {
+            ap_log_error(APLOG_MARK, APLOG_ERR, rv, s,
+                "mod_sslhaf: Failed to create the log mutex; not limiting the error log");
+            return;
+        }
+    }
+    #endif
+
+    ll->tokens = LOG_BURST;
+    ll->refill = apr_time_now();
+    ll->level = -1;
+
+    apr_pool_cleanup_register(pchild, ll, log_limit_stop, apr_pool_cleanup_null);
+
+    log_limit = ll;
+}
+
+/**
+ * Pick this child's set of counters and set up the rate limiting of
+ * its error log lines. Set up its end of the binary log and the export
+ * socket, and start its flusher.
+ */
+static void sslhaf_child_init(apr_pool_t *pchild, server_rec *s) {
+    sslhaf_binlog_t *bl;
+
+    if (stats_table != NULL) {
+        stats = STATS_SLOT(stats_table,
+            (apr_atomic_inc32(&stats_table->next) % stats_table->slots));
+    }
+
+    log_limit_init(pchild, s);
+
+    if ((binlog_file == NULL)&&(export_path == NULL)) {
+        return;
+    }
+
+    bl = apr_pcalloc(pchild, sizeof(sslhaf_binlog_t));
+    bl->file = binlog_file;
+    bl->export_path = export_path;
+    bl->batch = apr_palloc(pchild, BINLOG_BATCH);
+
+    // Zeroed: nothing in the ring is filled in yet
+    bl->ring = apr_pcalloc(pchild, BINLOG_RING);
+
+    #if APR_HAVE_SYS_UN_H
+    bl->sock = -1;
+    #endif
+
+    #if APR_HAS_THREADS
+    {
+        apr_status_t rv = apr_thread_create(&bl->thread, NULL, binlog_thread, bl, pchild);
+        if (rv != APR_SUCCESS) {
+            ap_log_error(APLOG_MARK, APLOG_ERR, rv, s,
+                "mod_sslhaf: Failed to start the binary log thread; not logging");
+            return;
+        }
+    }
+    #endif
+
+    // Before the thread's pool goes away with pchild's subpools
+    apr_pool_pre_cleanup_register(pchild, bl, binlog_stop);
+
+    binlog = bl;
+}
+
+/**
+ * Show the contents of the fingerprint table, one fingerprint per line.
+ */
+static int sslhaf_handler(request_rec *r) {
+    char hex[(SSLHAF_MD5_DIGESTSIZE * 2) + 1];
+    int i;
+
+    if (strcmp(r->handler, "sslhaf-fingerprints") != 0) {
+        return DECLINED;
+    }
+
+    if (fptable == NULL) {
+        return HTTP_NOT_FOUND;
+    }
+
+    ap_set_content_type(r, "text/plain");
+    if (r->header_only) {
+        return OK;
+    }
+
+    ap_rprintf(r, "# JA3_HASH count protocol first_seen last_seen\n");
+    ap_rprintf(r, "# dropped %u\n", apr_atomic_read32(&fptable->dropped));
+
+    for (i = 0; i < FPTABLE_SLOTS; i++) {
+        sslhaf_fp_entry_t *entry = &fptable->entries[i];
+
+        if (apr_atomic_read32(&entry->state) != FP_SLOT_READY) {
+            continue;
         }
+
+        sslhaf_hex_encode(entry->digest, SSLHAF_MD5_DIGESTSIZE, hex);
+        ap_rprintf(r, "%s %u %u %u %u\n", hex, apr_atomic_read32(&entry->count),
+            entry->protocol, entry->first_seen, apr_atomic_read32(&entry->last_seen));
     }
-    
-    return 1;
+
+    return OK;
 }
 
 /**
- * This input filter will basicall sniff on a connection and analyse
- * the packets when it detects SSL.
+ * Compare two heavy fingerprints by count, heaviest first.
  */
-static apr_status_t sslhaf_in_filter(ap_filter_t *f,
-                                    apr_bucket_brigade *bb,
-                                    ap_input_mode_t mode,
-                                    apr_read_type_e block,
-                                    apr_off_t readbytes)
-{
-    sslhaf_cfg_t *cfg = ap_get_module_config(f->c->conn_config, &sslhaf_module);
-    apr_status_t status;
-    apr_bucket *bucket;
-    
-    // Return straight away if there's no configuration
-    if (cfg == NULL) {
-        return ap_get_brigade(f->next, bb, mode, block, readbytes);
+static int topk_compare(const void *a, const void *b) {
+    apr_uint32_t ca = ((const sslhaf_topk_entry_t *)a)->count;
+    apr_uint32_t cb = ((const sslhaf_topk_entry_t *)b)->count;
+
+    return (ca < cb) ? 1 : (ca > cb) ? -1 : 0;
+}
+
+/**
+ * Show the TOPK_REPORT heaviest fingerprints from the sketch, or, given
+ * a JA3 hash as the query string, the estimate for it.
+ */
+static int sslhaf_top_handler(request_rec *r) {
+    char hex[(SSLHAF_MD5_DIGESTSIZE * 2) + 1];
+    sslhaf_topk_entry_t *top;
+    int i, j, n = 0;
+
+    if (strcmp(r->handler, "sslhaf-top") != 0) {
+        return DECLINED;
     }
-    
-    // Sanity check first
-    if (cfg->state == STATE_GOAWAY) {
-        return ap_get_brigade(f->next, bb, mode, block, readbytes);
+
+    if (sketch == NULL) {
+        return HTTP_NOT_FOUND;
     }
 
-    // Get the brigade
-    status = ap_get_brigade(f->next, bb, mode, block, readbytes);
-    if (status != APR_SUCCESS) {
-        cfg->state = STATE_GOAWAY;
-        return status;
+    if ((r->args != NULL)&&(r->args[0] != '\0')) {
+        unsigned char digest[SSLHAF_MD5_DIGESTSIZE];
+
+        if ((strlen(r->args) != SSLHAF_MD5_DIGESTSIZE * 2)
+            ||(sslhaf_hex_decode(r->args, SSLHAF_MD5_DIGESTSIZE, digest) < 0))
+        {
+            return HTTP_BAD_REQUEST;
+        }
+
+        ap_set_content_type(r, "text/plain");
+        if (!r->header_only) {
+            ap_rprintf(r, "%s %u\n", r->args, sketch_estimate(digest));
+        }
+
+        return OK;
     }
 
-    // Loop through the buckets
-    for(bucket = APR_BRIGADE_FIRST(bb);
-        bucket != APR_BRIGADE_SENTINEL(bb);
-        bucket = APR_BUCKET_NEXT(bucket))
-    {
-        const char *buf = NULL;
-        apr_size_t buflen = 0;
-        
-        if (!(APR_BUCKET_IS_METADATA(bucket))) {
-            // Get bucket data
-            status = apr_bucket_read(bucket, &buf, &buflen, APR_BLOCK_READ);
-            if (status != APR_SUCCESS) {
-                ap_log_error(APLOG_MARK, APLOG_ERR, status, f->c->base_server,
-                    "mod_sslhaf [%s]: Error while reading input bucket",
-                    CONN_REMOTE_IP(f->c));
-                return status;
-            }
-            
-            // Look into the bucket                
-            if (decode_bucket(f, cfg, (const unsigned char *)buf, buflen) <= 0) {
-                cfg->state = STATE_GOAWAY;
-                return APR_SUCCESS;
-            }
+    ap_set_content_type(r, "text/plain");
+    if (r->header_only) {
+        return OK;
+    }
 
-            // If there's no more work left to be done, break away            
-            if (cfg->state == STATE_GOAWAY) {
-                return APR_SUCCESS;
+    // Take a copy, so that the counts don't move while we sort them
+    top = apr_palloc(r->pool, TOPK_SETS * TOPK_WAYS * sizeof(sslhaf_topk_entry_t));
+
+    for (i = 0; i < TOPK_SETS; i++) {
+        for (j = 0; j < TOPK_WAYS; j++) {
+            sslhaf_topk_entry_t *entry = &sketch->topk[i][j];
+
+            if (TOPK_SLOT(apr_atomic_read32(&entry->state)) != FP_SLOT_READY) {
+                continue;
             }
+
+            memcpy(top[n].digest, entry->digest, SSLHAF_MD5_DIGESTSIZE);
+            top[n].count = apr_atomic_read32(&entry->count);
+            top[n].error = apr_atomic_read32(&entry->error);
+            n++;
         }
     }
-    
-    return APR_SUCCESS;
+
+    qsort(top, n, sizeof(sslhaf_topk_entry_t), topk_compare);
+
+    ap_rprintf(r, "# JA3_HASH count error\n");
+    ap_rprintf(r, "# total %u\n", apr_atomic_read32(&sketch->total));
+
+    for (i = 0; (i < n)&&(i < TOPK_REPORT); i++) {
+        sslhaf_hex_encode(top[i].digest, SSLHAF_MD5_DIGESTSIZE, hex);
+        ap_rprintf(r, "%s %u %u\n", hex, top[i].count, top[i].error);
+    }
+
+    return OK;
 }
 
 /**
- * Attach our filter to every incoming connection.
+ * Add up the counters of all the children.
  */
-static int sslhaf_pre_conn(conn_rec *c, void *csd) {
-    sslhaf_cfg_t *cfg = NULL;
-    
-    cfg = apr_pcalloc(c->pool, sizeof(*cfg));
-    if (cfg == NULL) return OK;
-    
-    ap_set_module_config(c->conn_config, &sslhaf_module, cfg);
+static void stats_sum(sslhaf_stats_t *total) {
+    apr_uint32_t i;
+    int j;
 
-    ap_add_input_filter(sslhaf_in_filter_name, NULL, NULL, c);
+    memset(total, 0, sizeof(*total));
 
-    #ifdef ENABLE_DEBUG    
-    ap_log_error(APLOG_MARK, APLOG_DEBUG, 0, c->base_server,
-        "mod_sslhaf: Connection from %s", c->remote_ip);
-    #endif
+    for (i = 0; i < stats_table->slots; i++) {
+        sslhaf_stats_t *slot = STATS_SLOT(stats_table, i);
+
+        total->connections += STATS_READ(slot->connections);
+        total->fingerprinted += STATS_READ(slot->fingerprinted);
+        total->no_hello += STATS_READ(slot->no_hello);
+
+        for (j = 1; j <= SSLHAF_E_MAX; j++) {
+            total->failed[j] += STATS_READ(slot->failed[j]);
+        }
+
+        for (j = 1; j <= SSLHAF_DECODE_CODES; j++) {
+            total->decode_rc[j] += STATS_READ(slot->decode_rc[j]);
+        }
+
+        total->bytes += STATS_READ(slot->bytes);
+        total->buckets += STATS_READ(slot->buckets);
+        total->spanning += STATS_READ(slot->spanning);
+        total->parse_time += STATS_READ(slot->parse_time);
+        total->blocked += STATS_READ(slot->blocked);
+        total->rate_limited += STATS_READ(slot->rate_limited);
+    }
+}
+
+/* How to write the counters: "name value" lines for the sslhaf-status
+ * handler, "SSLHAF_name: value" lines for mod_status with ?auto, or
+ * HTML for its status page. */
+#define STATS_TEXT  0
+#define STATS_AUTO  1
+#define STATS_HTML  2
+
+/**
+ * Write one counter.
+ */
+static void stats_print(request_rec *r, int format, const char *name, apr_uint64_t value) {
+    if (format == STATS_TEXT) {
+        ap_rprintf(r, "%s %" APR_UINT64_T_FMT "\n", name, value);
+    } else if (format == STATS_AUTO) {
+        ap_rprintf(r, "SSLHAF_%s: %" APR_UINT64_T_FMT "\n", name, value);
+    } else {
+        ap_rprintf(r, "<dt>%s: %" APR_UINT64_T_FMT "</dt>\n", name, value);
+    }
+}
+
+/**
+ * Write all the counters.
+ */
+static void stats_report(request_rec *r, int format) {
+    sslhaf_stats_t total;
+    char name[32];
+    int i;
+
+    stats_sum(&total);
+
+    stats_print(r, format, "connections", total.connections);
+    stats_print(r, format, "fingerprinted", total.fingerprinted);
+    stats_print(r, format, "no_hello", total.no_hello);
+
+    for (i = 1; i <= SSLHAF_E_MAX; i++) {
+        apr_snprintf(name, sizeof(name), "failed_%s", sslhaf_failure_names[i]);
+        stats_print(r, format, name, total.failed[i]);
+    }
+
+    for (i = 1; i <= SSLHAF_DECODE_CODES; i++) {
+        apr_snprintf(name, sizeof(name), "decode_rc_%d", -i);
+        stats_print(r, format, name, total.decode_rc[i]);
+    }
+
+    stats_print(r, format, "bytes", total.bytes);
+    stats_print(r, format, "buckets", total.buckets);
+    stats_print(r, format, "spanning_records", total.spanning);
+    stats_print(r, format, "parse_" STATS_CLOCK_UNIT, total.parse_time);
+    stats_print(r, format, "blocked", total.blocked);
+    stats_print(r, format, "rate_limited", total.rate_limited);
+}
+
+/**
+ * Show the counters, one per line.
+ */
+static int sslhaf_stats_handler(request_rec *r) {
+    if (strcmp(r->handler, "sslhaf-status") != 0) {
+        return DECLINED;
+    }
+
+    if (stats_table == NULL) {
+        return HTTP_NOT_FOUND;
+    }
+
+    ap_set_content_type(r, "text/plain");
+    if (r->header_only) {
+        return OK;
+    }
+
+    stats_report(r, STATS_TEXT);
 
     return OK;
 }
 
-char * str_to_dec(char* string) {
-    char * str = malloc(10);
-    int cur = 0;
-    int res = 0;
-    int length = strlen(string);
-    length--;
+/**
+ * Add the counters to mod_status's server-status page.
+ */
+static int sslhaf_status_hook(request_rec *r, int flags) {
+    if (stats_table == NULL) {
+        return OK;
+    }
 
-    for (int i = 0; string[i] != '\0'; i++) {
-        if (string[i]>='0' && string[i]<='9') {
-            cur = string[i] - 48;
-        } else if(string[i]>='a' && string[i]<='f') {
-            cur = string[i] - 87;
-        }
-        res += cur * pow(16, length);
-        length--;
+    if (flags & AP_STATUS_SHORT) {
+        stats_report(r, STATS_AUTO);
+    } else {
+        ap_rputs("<hr />\n<h2>mod_sslhaf</h2>\n<dl>\n", r);
+        stats_report(r, STATS_HTML);
+        ap_rputs("</dl>\n", r);
     }
-    sprintf(str, "%d-", res);
-    return str;
+
+    return OK;
 }
 
 /**
- * Take the textual representation of the client's cipher suite
- * list and attach it to the request.
+ * Create the per-server configuration.
  */
-static int sslhaf_post_request(request_rec *r) {
-    sslhaf_cfg_t *cfg = ap_get_module_config(r->connection->conn_config, &sslhaf_module);
-    
-    if ((cfg != NULL)&&(cfg->tsuites != NULL)) {
-        // Release the packet buffer if we're still holding it
-        if (cfg->buf != NULL) {
-            free(cfg->buf);
-            cfg->buf = NULL;
-        }
-        
-        // Make the handshake information available to other modules
-        apr_table_setn(r->subprocess_env, "SSLHAF_HANDSHAKE", cfg->thandshake);
-        char * protocol_ver;
-        if (strcmp("3.0", cfg->tprotocol) == 0) {
-            protocol_ver = "768";
-        } else if (strcmp("3.1", cfg->tprotocol) == 0) {
-            protocol_ver = "769";
-        } else if (strcmp("3.2", cfg->tprotocol) == 0) {
-            protocol_ver = "770";
-        } else if (strcmp("3.3", cfg->tprotocol) == 0) {
-            protocol_ver = "771";
-        } else {
-        }
+static void *sslhaf_create_srv_config(apr_pool_t *p, server_rec *s) {
+    sslhaf_srv_cfg_t *scfg = apr_pcalloc(p, sizeof(sslhaf_srv_cfg_t));
 
-        apr_table_setn(r->subprocess_env, "SSLHAF_PROTOCOL", protocol_ver);
+    scfg->enable = -1;
+    scfg->outputs = -1;
+    scfg->backend = -1;
 
-        char grease_table[][5] = { "0a0a", "1a1a", "2a2a", "3a3a", 
-        "4a4a", "5a5a", "6a6a", "7a7a", "8a8a", "9a9a", "aaaa", "baba",
-        "caca", "dada", "eaea", "fafa"};
+    return scfg;
+}
 
-        char * suites = calloc(1000, 1);
-        char ste2[1000];
-        strcpy(ste2, cfg->tsuites);
-        char * token = strtok(ste2, ",");
+/**
+ * Merge virtual host configuration with that of the main server.
+ */
+static void *sslhaf_merge_srv_config(apr_pool_t *p, void *basev, void *addv) {
+    sslhaf_srv_cfg_t *base = basev;
+    sslhaf_srv_cfg_t *add = addv;
+    sslhaf_srv_cfg_t *scfg = apr_pcalloc(p, sizeof(sslhaf_srv_cfg_t));
+
+    scfg->clientdb_file = base->clientdb_file;
+    scfg->binlog_file = base->binlog_file;
+    scfg->export_socket = base->export_socket;
+    scfg->enable = (add->enable != -1) ? add->enable : base->enable;
+    scfg->outputs = (add->outputs != -1) ? add->outputs : base->outputs;
+    scfg->max_record = (add->max_record != 0) ? add->max_record : base->max_record;
+    scfg->backend = (add->backend != -1) ? add->backend : base->backend;
+    scfg->block = base->block;
+    scfg->rate = base->rate;
+    scfg->burst = base->burst;
+
+    return scfg;
+}
 
-        while (token != NULL) {
-            int to_convert = 1;
-            for (int i = 0; i<16; i++) {
-                if (strcmp(token, grease_table[i]) == 0) {
-                    to_convert = 0;
-                    break;
-                }
-            }
-            if (to_convert) {
-                strcat(suites, str_to_dec(token));
-            }
-            token = strtok(NULL, ",");
-        }
-        suites[strlen(suites)-1] = '\0';
-        apr_table_setn(r->subprocess_env, "SSLHAF_SUITES", suites);
+/**
+ * Handle SSLHAFClientDB.
+ */
+static const char *sslhaf_cmd_clientdb(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
 
-        // Expose compression methods
-        apr_table_setn(r->subprocess_env, "SSLHAF_COMPRESSION", cfg->compression_methods);
-        
-        // Expose extension data
-        char *extensions_len = apr_psprintf(r->pool, "%d", cfg->extensions_len);
-        apr_table_setn(r->subprocess_env, "SSLHAF_EXTENSIONS_LEN", extensions_len);
-        char * ext = calloc(1000, 1);
-        char ext_cpy[1000];
-        strcpy(ext_cpy, cfg->extensions);
-        token = strtok(ext_cpy, ",");
-
-        while (token != NULL) {
-            int to_convert = 1;
-            for (int i = 0; i<16; i++) {
-                if (strcmp(token, grease_table[i]) == 0) {
-                    to_convert = 0;
-                    break;
-                }
-            }
-            if (to_convert) {
-                strcat(ext, str_to_dec(token));
-            }
-            token = strtok(NULL, ",");
-        }
-        ext[strlen(ext)-1] = '\0';
-        apr_table_setn(r->subprocess_env, "SSLHAF_EXTENSIONS", ext);
+    if (err != NULL) {
+        return err;
+    }
 
-        // Expose ec_point_format and curves
-        // char *ec = apr_psprintf(r->pool, "%d", cfg->ec_point);
-
-        char * ec_pt = calloc(1000, 1);
-        char ec_cpy[1000];
-        strcpy(ec_cpy, cfg->ec_point);
-        if (strlen(ec_cpy) > 2) {
-            token = strtok(ec_cpy, ",");
-
-            while (token != NULL) {
-                int to_convert = 1;
-                for (int i = 0; i<16; i++) {
-                    if (strcmp(token, grease_table[i]) == 0) {
-                        to_convert = 0;
-                        break;
-                    }
-                }
-                if (to_convert) {
-                    strcat(ec_pt, str_to_dec(token));
-                }
-                token = strtok(NULL, ",");
-            }
-        } else {
-            strcat(ec_pt, str_to_dec(ec_cpy));
-        }
+    scfg->clientdb_file = ap_server_root_relative(cmd->pool, arg);
+    if (scfg->clientdb_file == NULL) {
+        return apr_pstrcat(cmd->pool, "Invalid client database path: ", arg, NULL);
+    }
+
+    return NULL;
+}
+
+/**
+ * Handle SSLHAFBinaryLog.
+ */
+static const char *sslhaf_cmd_binlog(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
 
-        ec_pt[strlen(ec_pt)-1] = '\0';
+    if (err != NULL) {
+        return err;
+    }
 
-        apr_table_setn(r->subprocess_env, "EC_POINT", ec_pt);
+    scfg->binlog_file = ap_server_root_relative(cmd->pool, arg);
+    if (scfg->binlog_file == NULL) {
+        return apr_pstrcat(cmd->pool, "Invalid binary log path: ", arg, NULL);
+    }
 
-        char * curves = calloc(1000, 1);
-        char curve_cpy[1000];
-        strcpy(curve_cpy, cfg->curves);
-        token = strtok(curve_cpy, ",");
+    return NULL;
+}
 
-        while (token != NULL) {
-            int to_convert = 1;
-            for (int i = 0; i<16; i++) {
-                if (strcmp(token, grease_table[i]) == 0) {
-                    to_convert = 0;
-                    break;
-                }
-            }
-            if (to_convert) {
-                strcat(curves, str_to_dec(token));
-            }
-            token = strtok(NULL, ",");
-        }
-        curves[strlen(curves)-1] = '\0';
+/**
+ * Handle SSLHAFExportSocket.
+ */
+static const char *sslhaf_cmd_export(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
 
-        apr_table_setn(r->subprocess_env, "CURVES", curves);
+    if (err != NULL) {
+        return err;
+    }
 
+    #if APR_HAVE_SYS_UN_H
+    {
+        struct sockaddr_un addr;
+        const char *path = ap_server_root_relative(cmd->pool, arg);
 
-        // Keep track of how many requests there were
-        cfg->request_counter++;
-        
-        // Help to log only once per connection
-        if (cfg->request_counter == 1) {
-            apr_table_setn(r->subprocess_env, "SSLHAF_LOG", "1");
+        if ((path == NULL)||(strlen(path) >= sizeof(addr.sun_path))) {
+            return apr_pstrcat(cmd->pool, "Invalid export socket path: ", arg, NULL);
         }
-        // char * hash = calloc(APR_MD5_DIGESTSIZE, 1);
-        // strcpy(hash, generate_ja3(protocol_ver, suites, ext, curves, ec_pt));
-        unsigned char digest[APR_MD5_DIGESTSIZE];
-        const char * ja3 = generate_ja3(r->connection->pool, digest, protocol_ver, suites, ext, curves, ec_pt);
-        apr_table_setn(r->subprocess_env, "JA3_HASH", ja3);
-        
-        #if 0
-        // Generate a sha1 of the remote address on the first request
-        if (cfg->ipaddress_hash == NULL) {
-            cfg->ipaddress_hash = generate_sha1(r->connection->pool,
-                r->connection->remote_ip, strlen(r->connection->remote_ip));
+
+        scfg->export_socket = path;
+    }
+
+    return NULL;
+    #else
+    (void)scfg;
+    return "SSLHAFExportSocket is not supported on this platform";
+    #endif
+}
+
+/**
+ * Handle SSLHAFEnable.
+ */
+static const char *sslhaf_cmd_enable(cmd_parms *cmd, void *dummy, int flag) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+
+    scfg->enable = flag;
+
+    return NULL;
+}
+
+/**
+ * Handle SSLHAFOutputs, which is given one output at a time. The
+ * first one replaces the default of all outputs.
+ */
+static const char *sslhaf_cmd_outputs(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    int i;
+
+    for (i = 0; sslhaf_outputs[i].name != NULL; i++) {
+        if (strcasecmp(arg, sslhaf_outputs[i].name) == 0) {
+            break;
         }
-        
-        apr_table_setn(r->subprocess_env, "SSLHAF_IP_HASH", cfg->ipaddress_hash);
+    }
+
+    if (sslhaf_outputs[i].name == NULL) {
+        return apr_pstrcat(cmd->pool, "Unknown SSLHAFOutputs value: ", arg, NULL);
+    }
+
+    if (scfg->outputs == -1) {
+        scfg->outputs = 0;
+    }
+
+    scfg->outputs |= sslhaf_outputs[i].flags;
+
+    return NULL;
+}
+
+/**
+ * Handle SSLHAFBackend.
+ */
+static const char *sslhaf_cmd_backend(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+
+    if (strcasecmp(arg, "filter") == 0) {
+        scfg->backend = SSLHAF_BACKEND_FILTER;
+    } else if (strcasecmp(arg, "openssl") == 0) {
+        #ifdef SSLHAF_WITH_OPENSSL
+        scfg->backend = SSLHAF_BACKEND_OPENSSL;
+        #else
+        return "SSLHAFBackend openssl needs mod_sslhaf compiled with -DSSLHAF_WITH_OPENSSL";
         #endif
-        
-        // Raw ClientHello
-        if (cfg->client_hello != NULL) {
-            apr_table_setn(r->subprocess_env, "SSLHAF_RAW", cfg->client_hello);
-        } else {
-            apr_table_setn(r->subprocess_env, "SSLHAF_RAW", "-");
+    } else {
+        return apr_pstrcat(cmd->pool, "Unknown SSLHAFBackend value: ", arg, NULL);
+    }
+
+    return NULL;
+}
+
+/**
+ * Handle SSLHAFMaxRecord.
+ */
+static const char *sslhaf_cmd_max_record(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    char *end = NULL;
+    long value = strtol(arg, &end, 10);
+
+    if ((end == arg)||(*end != '\0')||(value < 512)||(value > SSLHAF_HELLO_LIMIT)) {
+        return apr_psprintf(cmd->pool, "SSLHAFMaxRecord must be between 512 and %d: %s",
+            SSLHAF_HELLO_LIMIT, arg);
+    }
+
+    scfg->max_record = value;
+
+    return NULL;
+}
+
+/**
+ * Handle SSLHAFBlock, which is given one label at a time.
+ */
+static const char *sslhaf_cmd_block(cmd_parms *cmd, void *dummy, const char *arg) {
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+
+    if (err != NULL) {
+        return err;
+    }
+
+    if (scfg->block == NULL) {
+        scfg->block = apr_array_make(cmd->pool, 4, sizeof(const char *));
+    }
+
+    *(const char **)apr_array_push(scfg->block) = arg;
+
+    return NULL;
+}
+
+/**
+ * Handle SSLHAFRateLimit.
+ */
+static const char *sslhaf_cmd_rate_limit(cmd_parms *cmd, void *dummy, const char *arg1,
+    const char *arg2)
+{
+    sslhaf_srv_cfg_t *scfg = ap_get_module_config(cmd->server->module_config, &sslhaf_module);
+    const char *err = ap_check_cmd_context(cmd, GLOBAL_ONLY);
+    char *end = NULL;
+    double rate;
+    long burst;
+
+    if (err != NULL) {
+        return err;
+    }
+
+    rate = strtod(arg1, &end);
+    if ((end == arg1)||(*end != '\0')||(!(rate > 0))||(rate > 1000000)) {
+        return apr_pstrcat(cmd->pool, "SSLHAFRateLimit rate must be between 0 and 1000000: ",
+            arg1, NULL);
+    }
+
+    // By default, a second's worth of connections at once
+    burst = (rate > 1) ? (long)rate : 1;
+    if (arg2 != NULL) {
+        burst = strtol(arg2, &end, 10);
+        if ((end == arg2)||(*end != '\0')||(burst < 1)||(burst > 1000000)) {
+            return apr_pstrcat(cmd->pool, "SSLHAFRateLimit burst must be between 1 and 1000000: ",
+                arg2, NULL);
         }
     }
-    
-    return DECLINED;
+
+    scfg->rate = rate;
+    scfg->burst = burst;
+
+    return NULL;
 }
 
+static const command_rec sslhaf_cmds[] = {
+    AP_INIT_TAKE1("SSLHAFClientDB", sslhaf_cmd_clientdb, NULL, RSRC_CONF,
+        "File with known JA3 hashes and their client labels"),
+    AP_INIT_TAKE1("SSLHAFBinaryLog", sslhaf_cmd_binlog, NULL, RSRC_CONF,
+        "File to append binary ClientHello records to"),
+    AP_INIT_TAKE1("SSLHAFExportSocket", sslhaf_cmd_export, NULL, RSRC_CONF,
+        "Unix datagram socket to send binary ClientHello records to"),
+    AP_INIT_FLAG("SSLHAFEnable", sslhaf_cmd_enable, NULL, RSRC_CONF,
+        "Whether to fingerprint connections to this server (default On)"),
+    AP_INIT_ITERATE("SSLHAFOutputs", sslhaf_cmd_outputs, NULL, RSRC_CONF,
+        "Outputs to compute: suites, compression, extensions, curves, ja3, ja4, raw or all"),
+    AP_INIT_TAKE1("SSLHAFMaxRecord", sslhaf_cmd_max_record, NULL, RSRC_CONF,
+        "Largest ClientHello to inspect, in bytes of record data"),
+    AP_INIT_TAKE1("SSLHAFBackend", sslhaf_cmd_backend, NULL, RSRC_CONF,
+        "Where to get the ClientHello from: filter (the default) or openssl"),
+    AP_INIT_ITERATE("SSLHAFBlock", sslhaf_cmd_block, NULL, RSRC_CONF,
+        "Client database labels whose connections to close before the handshake"),
+    AP_INIT_TAKE12("SSLHAFRateLimit", sslhaf_cmd_rate_limit, NULL, RSRC_CONF,
+        "Connections a second allowed per JA3 fingerprint, and the burst"),
+    { NULL }
+};
+
 /**
  * Main entry point.
  */
 static void register_hooks(apr_pool_t *p) {
     static const char * const afterme[] = { "mod_security2.c", NULL };
+    static const char * const beforeme[] = { "mod_ssl.c", NULL };
     
-    ap_hook_pre_connection(sslhaf_pre_conn, NULL, NULL, APR_HOOK_MIDDLE);
+    ap_hook_post_config(sslhaf_post_config, NULL, NULL, APR_HOOK_MIDDLE);
+    ap_hook_child_init(sslhaf_child_init, NULL, NULL, APR_HOOK_MIDDLE);
+    ap_hook_pre_connection(sslhaf_pre_conn, beforeme, NULL, APR_HOOK_MIDDLE);
     ap_hook_post_read_request(sslhaf_post_request, NULL, afterme, APR_HOOK_REALLY_FIRST);
+    ap_hook_handler(sslhaf_handler, NULL, NULL, APR_HOOK_MIDDLE);
+    ap_hook_handler(sslhaf_stats_handler, NULL, NULL, APR_HOOK_MIDDLE);
+    ap_hook_handler(sslhaf_top_handler, NULL, NULL, APR_HOOK_MIDDLE);
+    APR_OPTIONAL_HOOK(ap, status_hook, sslhaf_status_hook, NULL, NULL, APR_HOOK_MIDDLE);
+
+    #ifdef SSLHAF_WITH_OPENSSL
+    APR_OPTIONAL_HOOK(ssl, init_server, sslhaf_ssl_init_server, NULL, NULL, APR_HOOK_MIDDLE);
+    #endif
 
     ap_register_input_filter(sslhaf_in_filter_name, sslhaf_in_filter,
         NULL, AP_FTYPE_NETWORK - 1);
@@ -1254,8 +2890,8 @@ module AP_MODULE_DECLARE_DATA sslhaf_module = {
     STANDARD20_MODULE_STUFF,
     NULL,                       /* create per-dir config */
     NULL,                       /* merge per-dir config */
-    NULL,                       /* server config */
-    NULL,                       /* merge server config */
-    NULL,                       /* command apr_table_t */
+    sslhaf_create_srv_config,   /* server config */
+    sslhaf_merge_srv_config,    /* merge server config */
+    sslhaf_cmds,                /* command apr_table_t */
     register_hooks              /* register hooks */
 };
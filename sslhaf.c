@@ -0,0 +1,1811 @@
+/*
+
+libsslhaf: passive SSL client fingerprinting
+ 
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sslhaf.h"
+
+/* On x86, hex encoding uses SSE2 or AVX2 when the CPU has them, which
+ * is checked at run time; define SSLHAF_NO_SIMD to use plain C only. */
+#if !defined(SSLHAF_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__GNUC__) || defined(__clang__))
+#define SSLHAF_HEX_SIMD
+#include <immintrin.h>
+#endif
+
+/* Parser stages. The PARSE_V2_* stages are used for SSLv2 ClientHello,
+ * the others for the handshake message of SSLv3 and better. */
+#define PARSE_TYPE          0
+#define PARSE_LENGTH        1
+#define PARSE_VERSION       2
+#define PARSE_RANDOM        3
+#define PARSE_ID_LEN        4
+#define PARSE_ID            5
+#define PARSE_CS_LEN        6
+#define PARSE_CS            7
+#define PARSE_COMP_LEN      8
+#define PARSE_COMP          9
+#define PARSE_EXTS_LEN      10
+#define PARSE_EXT_TYPE      11
+#define PARSE_EXT_LEN       12
+#define PARSE_EXT_DATA      13
+#define PARSE_GROUPS_LEN    14
+#define PARSE_GROUPS        15
+#define PARSE_POINTS_LEN    16
+#define PARSE_POINTS        17
+#define PARSE_ALPN_LEN      18
+#define PARSE_ALPN_NAME_LEN 19
+#define PARSE_ALPN_NAME     20
+#define PARSE_SIGALGS_LEN   21
+#define PARSE_SIGALGS       22
+#define PARSE_VERSIONS_LEN  23
+#define PARSE_VERSIONS      24
+#define PARSE_V2_CS_LEN     25
+#define PARSE_V2_ID_LEN     26
+#define PARSE_V2_CH_LEN     27
+#define PARSE_V2_CS         28
+#define PARSE_V2_REST       29
+
+/* Everything we derive from the ClientHello is allocated from the
+ * caller's allocator: the packet itself for SSLHAF_OUTPUT_RAW, then the lists,
+ * each once the client has declared its length, and finally one block
+ * for the strings. All of it is bounded by the packet length, which is
+ * limited to SSLHAF_HELLO_LIMIT. A 2-byte value needs at most 6 bytes as a
+ * string ("65535-"), a 3-byte SSLv2 suite at most 9 ("16777215-") and
+ * a 1-byte value at most 4 ("255-" or "ff,"). */
+#define DEC16_LEN   6
+#define DEC24_LEN   9
+#define DEC8_LEN    4
+
+#define PROTOCOL_CHANGE_CIPHER_SPEC     20
+#define PROTOCOL_HANDSHAKE              22
+#define PROTOCOL_APPLICATION            23
+
+#define EXTENSION_SERVER_NAME           0
+#define EXTENSION_SUPPORTED_GROUPS      10
+#define EXTENSION_EC_POINT_FORMATS      11
+#define EXTENSION_SIGNATURE_ALGORITHMS  13
+#define EXTENSION_ALPN                  16
+#define EXTENSION_SUPPORTED_VERSIONS    43
+#define EXTENSION_RENEGOTIATION_INFO    0xff01
+
+/* GREASE values (RFC 8701) are 0x?a?a with both bytes equal. */
+#define IS_GREASE(V) ((((V) & 0x0f0f) == 0x0a0a) && (((V) >> 8) == ((V) & 0xff)))
+
+/* The suite and extension tables, generated from suites.csv and
+ * extensions.csv by sslhaf_tables.awk. */
+#include "sslhaf_tables.h"
+
+/**
+ * Allocate memory with the caller's allocator.
+ */
+static void *sslhaf_alloc(sslhaf_t *h, size_t size) {
+    // Empty lists still get a (tiny) allocation
+    return h->alloc(h->alloc_ctx, (size > 0) ? size : 1);
+}
+
+/**
+ * Describe why we're giving up on the connection. The first
+ * description is kept, as it's usually the most specific.
+ */
+static void sslhaf_error(sslhaf_t *h, int code, const char *fmt, ...) {
+    va_list ap;
+
+    if (h->error[0] != '\0') {
+        return;
+    }
+
+    h->error_code = code;
+
+    va_start(ap, fmt);
+    vsnprintf(h->error, sizeof(h->error), fmt, ap);
+    va_end(ap);
+}
+
+/**
+ * Hex encode len bytes, without the NUL, one byte at a time.
+ */
+static void hex_encode_scalar(const unsigned char *data, size_t len, char *hex) {
+    static const char b2hex[] = "0123456789abcdef";
+    size_t i, j;
+
+    j = 0;
+    for(i = 0; i < len; i++) {
+        hex[j++] = b2hex[data[i] >> 4];
+        hex[j++] = b2hex[data[i] & 0x0f];
+    }
+}
+
+#ifdef SSLHAF_HEX_SIMD
+
+/**
+ * Hex encode 16 bytes at a time with SSE2. There's no byte shuffle in
+ * SSE2, so the digits are computed: '0' + n, plus 39 more for n > 9.
+ */
+__attribute__((target("sse2")))
+static void hex_encode_sse2(const unsigned char *data, size_t len, char *hex) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+    size_t i;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+        __m128i lo = _mm_and_si128(v, mask);
+
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), gap));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), gap));
+
+        // Interleave, so that each byte's high digit comes first
+        _mm_storeu_si128((__m128i *)(hex + (i * 2)), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(hex + (i * 2) + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    hex_encode_scalar(data + i, len - i, hex + (i * 2));
+}
+
+/**
+ * Hex encode 32 bytes at a time with AVX2, looking the digits up with
+ * a byte shuffle. Shuffles and unpacks work within 128-bit lanes, so
+ * the halves are put back in order before they're stored.
+ */
+__attribute__((target("avx2")))
+static void hex_encode_avx2(const unsigned char *data, size_t len, char *hex) {
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i digits = _mm256_setr_epi8(
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(v, mask));
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+
+        _mm256_storeu_si256((__m256i *)(hex + (i * 2)), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(hex + (i * 2) + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    hex_encode_sse2(data + i, len - i, hex + (i * 2));
+}
+
+static void hex_encode_resolve(const unsigned char *data, size_t len, char *hex);
+
+/* The encoder for this CPU, chosen on first use. Racing threads all
+ * store the same value. */
+static void (*hex_encode_impl)(const unsigned char *, size_t, char *) = hex_encode_resolve;
+
+static void hex_encode_resolve(const unsigned char *data, size_t len, char *hex) {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        hex_encode_impl = hex_encode_avx2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        hex_encode_impl = hex_encode_sse2;
+    }
+    else {
+        hex_encode_impl = hex_encode_scalar;
+    }
+
+    hex_encode_impl(data, len, hex);
+}
+
+#endif
+
+/**
+ * Write the hexadecimal representation of the input bytes, followed
+ * by a NUL, into a buffer of at least (len * 2) + 1 bytes.
+ */
+char *sslhaf_hex_encode(const unsigned char *data, size_t len, char *hex) {
+#ifdef SSLHAF_HEX_SIMD
+    hex_encode_impl(data, len, hex);
+#else
+    hex_encode_scalar(data, len, hex);
+#endif
+
+    hex[len * 2] = '\0';
+
+    return hex;
+}
+
+/**
+ * Convert one hexadecimal character into its value, or -1.
+ */
+static int x2c(int what) {
+    if ((what >= '0')&&(what <= '9')) return what - '0';
+    if ((what >= 'a')&&(what <= 'f')) return what - 'a' + 10;
+    if ((what >= 'A')&&(what <= 'F')) return what - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Convert a string of hexadecimal characters back into len bytes.
+ * Returns -1 if the string has anything other than hex digits.
+ */
+int sslhaf_hex_decode(const char *hex, size_t len, unsigned char *data) {
+    size_t i;
+
+    for(i = 0; i < len; i++) {
+        int hi = x2c(hex[i * 2]), lo;
+
+        if (hi < 0) return -1;
+
+        lo = x2c(hex[(i * 2) + 1]);
+        if (lo < 0) return -1;
+
+        data[i] = (hi << 4) | lo;
+    }
+
+    return 0;
+}
+
+const sslhaf_suite_t *sslhaf_suite(uint32_t id) {
+    unsigned int page, i;
+
+    // There are only a few SSLv2 suites, at the start of the table
+    if (id > 0xffff) {
+        for (i = 0; i < SUITES_V2; i++) {
+            if (suite_table[i].id == id) {
+                return &suite_table[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    page = suite_pages[id >> 8];
+    if (page == 0) {
+        return NULL;
+    }
+
+    i = suite_index[page - 1][id & 0xff];
+
+    return (i != 0) ? &suite_table[i - 1] : NULL;
+}
+
+const char *sslhaf_extension_name(unsigned int type) {
+    unsigned int page, i;
+
+    if (type > 0xffff) {
+        return NULL;
+    }
+
+    page = extension_pages[type >> 8];
+    if (page == 0) {
+        return NULL;
+    }
+
+    i = extension_index[page - 1][type & 0xff];
+
+    return (i != 0) ? extension_table[i - 1] : NULL;
+}
+
+/* MD5 (RFC 1321), for JA3. */
+typedef struct sslhaf_md5_ctx_t {
+    uint32_t state[4];
+    uint64_t length;
+    unsigned char block[64];
+    size_t block_len;
+} sslhaf_md5_ctx_t;
+
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const unsigned char md5_r[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+#define ROTL32(X,N) (((X) << (N)) | ((X) >> (32 - (N))))
+
+static void md5_block(sslhaf_md5_ctx_t *ctx, const unsigned char *p) {
+    uint32_t w[16], a, b, c, d, f, t;
+    int i, g;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = p[i * 4] | ((uint32_t)p[(i * 4) + 1] << 8)
+            | ((uint32_t)p[(i * 4) + 2] << 16) | ((uint32_t)p[(i * 4) + 3] << 24);
+    }
+
+    a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+
+    for (i = 0; i < 64; i++) {
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = ((5 * i) + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = ((3 * i) + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+
+        t = d;
+        d = c;
+        c = b;
+        b = b + ROTL32(a + f + md5_k[i] + w[g], md5_r[i]);
+        a = t;
+    }
+
+    ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+}
+
+static void md5_init(sslhaf_md5_ctx_t *ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xefcdab89;
+    ctx->state[2] = 0x98badcfe;
+    ctx->state[3] = 0x10325476;
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+static void md5_update(sslhaf_md5_ctx_t *ctx, const void *data, size_t len) {
+    const unsigned char *p = data;
+
+    ctx->length += len;
+
+    while (len > 0) {
+        size_t n = sizeof(ctx->block) - ctx->block_len;
+
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(ctx->block + ctx->block_len, p, n);
+        ctx->block_len += n;
+        p += n;
+        len -= n;
+
+        if (ctx->block_len == sizeof(ctx->block)) {
+            md5_block(ctx, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+static void md5_final(unsigned char *digest, sslhaf_md5_ctx_t *ctx) {
+    uint64_t bits = ctx->length * 8;
+    int i;
+
+    ctx->block[ctx->block_len++] = 0x80;
+
+    if (ctx->block_len > 56) {
+        memset(ctx->block + ctx->block_len, 0, sizeof(ctx->block) - ctx->block_len);
+        md5_block(ctx, ctx->block);
+        ctx->block_len = 0;
+    }
+
+    memset(ctx->block + ctx->block_len, 0, 56 - ctx->block_len);
+    for (i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (unsigned char)(bits >> (i * 8));
+    }
+
+    md5_block(ctx, ctx->block);
+
+    for (i = 0; i < 4; i++) {
+        digest[i * 4] = ctx->state[i];
+        digest[(i * 4) + 1] = ctx->state[i] >> 8;
+        digest[(i * 4) + 2] = ctx->state[i] >> 16;
+        digest[(i * 4) + 3] = ctx->state[i] >> 24;
+    }
+}
+
+/**
+ * Generate the JA3 hash from its five fields. The raw digest is stored
+ * in digest and its hex form, which needs (SSLHAF_MD5_DIGESTSIZE * 2) + 1
+ * bytes, in hex.
+ */
+static char *generate_ja3(char *hex, unsigned char *digest, const char *ver, const char *ciph,
+    const char *ext, const char *ec, const char *ec_pf)
+{
+    sslhaf_md5_ctx_t context;
+
+    md5_init(&context);
+    md5_update(&context, ver, strlen(ver));
+    md5_update(&context, ",", 1);
+    md5_update(&context, ciph, strlen(ciph));
+    md5_update(&context, ",", 1);
+    md5_update(&context, ext, strlen(ext));
+    md5_update(&context, ",", 1);
+    md5_update(&context, ec, strlen(ec));
+    md5_update(&context, ",", 1);
+    md5_update(&context, ec_pf, strlen(ec_pf));
+    md5_final(digest, &context);
+    
+    return sslhaf_hex_encode(digest, SSLHAF_MD5_DIGESTSIZE, hex);
+}
+
+/* SHA-256 (FIPS 180-4), for JA4. */
+#define SHA256_DIGESTSIZE 32
+
+typedef struct sslhaf_sha256_ctx_t {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t block_len;
+} sslhaf_sha256_ctx_t;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR32(X,N) (((X) >> (N)) | ((X) << (32 - (N))))
+
+static void sha256_block(sslhaf_sha256_ctx_t *ctx, const unsigned char *p) {
+    uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[(i * 4) + 1] << 16)
+            | ((uint32_t)p[(i * 4) + 2] << 8) | p[(i * 4) + 3];
+    }
+
+    for (i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+    e = ctx->state[4]; f = ctx->state[5]; g = ctx->state[6]; h = ctx->state[7];
+
+    for (i = 0; i < 64; i++) {
+        t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g))
+            + sha256_k[i] + w[i];
+        t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+    ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+}
+
+static void sha256_init(sslhaf_sha256_ctx_t *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+static void sha256_update(sslhaf_sha256_ctx_t *ctx, const void *data, size_t len) {
+    const unsigned char *p = data;
+
+    ctx->length += len;
+
+    while (len > 0) {
+        size_t n = sizeof(ctx->block) - ctx->block_len;
+
+        if (n > len) {
+            n = len;
+        }
+
+        memcpy(ctx->block + ctx->block_len, p, n);
+        ctx->block_len += n;
+        p += n;
+        len -= n;
+
+        if (ctx->block_len == sizeof(ctx->block)) {
+            sha256_block(ctx, ctx->block);
+            ctx->block_len = 0;
+        }
+    }
+}
+
+static void sha256_final(unsigned char *digest, sslhaf_sha256_ctx_t *ctx) {
+    uint64_t bits = ctx->length * 8;
+    int i;
+
+    ctx->block[ctx->block_len++] = 0x80;
+
+    if (ctx->block_len > 56) {
+        memset(ctx->block + ctx->block_len, 0, sizeof(ctx->block) - ctx->block_len);
+        sha256_block(ctx, ctx->block);
+        ctx->block_len = 0;
+    }
+
+    memset(ctx->block + ctx->block_len, 0, 56 - ctx->block_len);
+    for (i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (unsigned char)(bits >> (56 - (i * 8)));
+    }
+
+    sha256_block(ctx, ctx->block);
+
+    for (i = 0; i < 8; i++) {
+        digest[i * 4] = ctx->state[i] >> 24;
+        digest[(i * 4) + 1] = ctx->state[i] >> 16;
+        digest[(i * 4) + 2] = ctx->state[i] >> 8;
+        digest[(i * 4) + 3] = ctx->state[i];
+    }
+}
+
+/**
+ * Convert one byte into its hexadecimal representation.
+ */
+static unsigned char *c2x(unsigned what, unsigned char *where) {
+    static const char c2x_table[] = "0123456789abcdef";
+    
+    what = what & 0xff;
+    *where++ = c2x_table[what >> 4];
+    *where++ = c2x_table[what & 0x0f];
+                
+    return where;
+}
+
+/**
+ * Convert a number into its decimal representation. No terminating
+ * NUL is written; a pointer to the byte after the last digit is returned.
+ */
+static unsigned char *u2d(unsigned what, unsigned char *where) {
+    unsigned char digits[10];
+    int i = 0;
+
+    do {
+        digits[i++] = '0' + (what % 10);
+        what /= 10;
+    } while (what != 0);
+
+    while (i > 0) {
+        *where++ = digits[--i];
+    }
+
+    return where;
+}
+
+/**
+ * Write a JA3 list: the values in decimal, separated with dashes and
+ * with GREASE values left out. The list is NUL-terminated and a pointer
+ * to the byte after the terminator is returned.
+ */
+static unsigned char *ja3_list_u32(const uint32_t *values, size_t count,
+    unsigned char *where)
+{
+    unsigned char *start = where;
+
+    while (count--) {
+        uint32_t value = *values++;
+
+        if (IS_GREASE(value)) {
+            continue;
+        }
+
+        if (where != start) {
+            *where++ = '-';
+        }
+
+        where = u2d(value, where);
+    }
+
+    *where++ = '\0';
+
+    return where;
+}
+
+/**
+ * Write a JA3 list of 2-byte values. See ja3_list_u32().
+ */
+static unsigned char *ja3_list_u16(const uint16_t *values, size_t count,
+    unsigned char *where)
+{
+    unsigned char *start = where;
+
+    while (count--) {
+        unsigned value = *values++;
+
+        if (IS_GREASE(value)) {
+            continue;
+        }
+
+        if (where != start) {
+            *where++ = '-';
+        }
+
+        where = u2d(value, where);
+    }
+
+    *where++ = '\0';
+
+    return where;
+}
+
+/**
+ * Write a JA3 list of 1-byte values, which are never GREASE. See
+ * ja3_list_u32().
+ */
+static unsigned char *ja3_list_u8(const unsigned char *values, size_t count,
+    unsigned char *where)
+{
+    unsigned char *start = where;
+
+    while (count--) {
+        if (where != start) {
+            *where++ = '-';
+        }
+
+        where = u2d(*values++, where);
+    }
+
+    *where++ = '\0';
+
+    return where;
+}
+
+/**
+ * Is this an ASCII letter or digit?
+ */
+static int is_alnum(int what) {
+    return ((what >= '0')&&(what <= '9')) || ((what >= 'a')&&(what <= 'z'))
+        || ((what >= 'A')&&(what <= 'Z'));
+}
+
+/**
+ * Compare two 2-byte values, for qsort().
+ */
+static int u16_compare(const void *a, const void *b) {
+    return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+/**
+ * Write a JA4 list: the values as 4 hex digits, separated with commas.
+ * No terminating NUL is written; a pointer to the byte after the last
+ * value is returned.
+ */
+static unsigned char *ja4_list(const uint16_t *values, size_t count,
+    unsigned char *where)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (i != 0) {
+            *where++ = ',';
+        }
+
+        where = c2x(values[i] >> 8, where);
+        where = c2x(values[i], where);
+    }
+
+    return where;
+}
+
+/**
+ * Write the first 12 hex digits of the SHA-256 of the given string, or
+ * 12 zeros when it is empty. No terminating NUL is written.
+ */
+static char *ja4_hash(const unsigned char *data, size_t len, char *where) {
+    unsigned char digest[SHA256_DIGESTSIZE];
+    sslhaf_sha256_ctx_t context;
+
+    if (len == 0) {
+        memset(where, '0', 12);
+        return where + 12;
+    }
+
+    sha256_init(&context);
+    sha256_update(&context, data, len);
+    sha256_final(digest, &context);
+
+    sslhaf_hex_encode(digest, 6, where);
+
+    return where + 12;
+}
+
+/**
+ * Generate the JA4 fingerprint into h->ja4. Suites and extensions are
+ * sorted, which makes JA4 immune to the extension order randomisation
+ * some browsers do; GREASE values are left out everywhere. Scratch space
+ * comes from the allocator. Returns -1 if it fails.
+ */
+static int generate_ja4(sslhaf_t *h) {
+    uint16_t *values;
+    unsigned char *list, *q;
+    size_t i, n, suites, extensions;
+    unsigned int version;
+    char *j = h->ja4;
+
+    n = (h->slen > h->extensions_len + h->sigalgs_len)
+        ? h->slen : h->extensions_len + h->sigalgs_len;
+    values = sslhaf_alloc(h, (n + 1) * sizeof(uint16_t));
+    list = sslhaf_alloc(h, (n + 1) * 5);
+    if ((values == NULL)||(list == NULL)) {
+        return -1;
+    }
+
+    // Cipher suites, sorted
+    for (i = 0, suites = 0; i < h->slen; i++) {
+        if (!IS_GREASE(h->suites[i])) {
+            values[suites++] = h->suites[i];
+        }
+    }
+
+    qsort(values, suites, sizeof(uint16_t), u16_compare);
+    q = ja4_list(values, suites, list);
+
+    // The middle part of the fingerprint; we write it later
+    ja4_hash(list, q - list, j + 11);
+
+    // Extensions, sorted, without SNI and ALPN, which the first
+    // part of the fingerprint covers, and then the signature
+    // algorithms in the order they were sent
+    for (i = 0, extensions = 0, n = 0; i < h->extensions_len; i++) {
+        uint16_t type = h->extension_ids[i];
+
+        if (IS_GREASE(type)) {
+            continue;
+        }
+
+        extensions++;
+
+        if ((type != EXTENSION_SERVER_NAME)&&(type != EXTENSION_ALPN)) {
+            values[n++] = type;
+        }
+    }
+
+    if (n > 0) {
+        qsort(values, n, sizeof(uint16_t), u16_compare);
+        q = ja4_list(values, n, list);
+
+        for (i = 0, n = 0; i < h->sigalgs_len; i++) {
+            if (!IS_GREASE(h->sigalgs[i])) {
+                values[n++] = h->sigalgs[i];
+            }
+        }
+
+        if (n > 0) {
+            *q++ = '_';
+            q = ja4_list(values, n, q);
+        }
+    } else {
+        q = list;
+    }
+
+    ja4_hash(list, q - list, j + 24);
+
+    // Transport, always TCP here, and the best version offered
+    *j++ = 't';
+
+    version = h->supported_version;
+    if (version == 0) {
+        version = (h->protocol_high * 256) + h->protocol_low;
+    }
+
+    switch (version) {
+    case 0x0304 : memcpy(j, "13", 2); break;
+    case 0x0303 : memcpy(j, "12", 2); break;
+    case 0x0302 : memcpy(j, "11", 2); break;
+    case 0x0301 : memcpy(j, "10", 2); break;
+    case 0x0300 : memcpy(j, "s3", 2); break;
+    case 0x0002 : memcpy(j, "s2", 2); break;
+    default : memcpy(j, "00", 2); break;
+    }
+    j += 2;
+
+    // SNI: to a domain or to an IP address (i.e., none)
+    *j++ = h->sni ? 'd' : 'i';
+
+    // Number of suites and extensions, capped at 99
+    if (suites > 99) suites = 99;
+    if (extensions > 99) extensions = 99;
+    *j++ = '0' + (suites / 10);
+    *j++ = '0' + (suites % 10);
+    *j++ = '0' + (extensions / 10);
+    *j++ = '0' + (extensions % 10);
+
+    // First and last character of the first ALPN protocol,
+    // or of its hex form if either isn't alphanumeric
+    if (h->alpn_len == 0) {
+        *j++ = '0';
+        *j++ = '0';
+    } else if ((is_alnum(h->alpn_first))&&(is_alnum(h->alpn_last))) {
+        *j++ = h->alpn_first;
+        *j++ = h->alpn_last;
+    } else {
+        unsigned char hex[2];
+
+        c2x(h->alpn_first, hex);
+        *j++ = hex[0];
+        c2x(h->alpn_last, hex);
+        *j++ = hex[1];
+    }
+
+    h->ja4[10] = '_';
+    h->ja4[23] = '_';
+    h->ja4[SSLHAF_JA4_LEN] = '\0';
+
+    return 0;
+}
+
+/**
+ * Completes the fingerprint once the whole ClientHello has been parsed:
+ * the JA3 fields, compression methods and raw packet are written out
+ * as strings, and the JA3 and JA4 fingerprints are computed, as far as
+ * the requested outputs need them. Returns -1 if memory runs out.
+ */
+static int finish_fingerprint(sslhaf_t *h) {
+    unsigned int outputs = h->outputs;
+    unsigned char *q;
+    size_t i, size = 0;
+
+    // Work out how much room the requested strings need
+    if (outputs & (SSLHAF_OUTPUT_SUITES|SSLHAF_OUTPUT_JA3)) {
+        size += (h->slen * DEC24_LEN) + 1;
+    }
+
+    if (outputs & (SSLHAF_OUTPUT_EXTENSIONS|SSLHAF_OUTPUT_JA3)) {
+        size += (h->extensions_len * DEC16_LEN) + 1;
+    }
+
+    if (outputs & (SSLHAF_OUTPUT_CURVES|SSLHAF_OUTPUT_JA3)) {
+        size += (h->curves_len * DEC16_LEN) + (h->ec_point_len * DEC8_LEN) + 2;
+    }
+
+    if (outputs & SSLHAF_OUTPUT_COMPRESSION) {
+        size += (h->compression_len * DEC8_LEN) + 1;
+    }
+
+    if (outputs & SSLHAF_OUTPUT_RAW) {
+        size += (h->raw_len * 2) + 1;
+    }
+
+    q = sslhaf_alloc(h, size);
+    if (q == NULL) {
+        return -1;
+    }
+
+    if (outputs & (SSLHAF_OUTPUT_SUITES|SSLHAF_OUTPUT_JA3)) {
+        h->tja3_suites = (const char *)q;
+        q = ja3_list_u32(h->suites, h->slen, q);
+    }
+
+    if (outputs & (SSLHAF_OUTPUT_EXTENSIONS|SSLHAF_OUTPUT_JA3)) {
+        h->tja3_extensions = (const char *)q;
+        q = ja3_list_u16(h->extension_ids, h->extensions_len, q);
+    }
+
+    if (outputs & (SSLHAF_OUTPUT_CURVES|SSLHAF_OUTPUT_JA3)) {
+        h->tja3_curves = (const char *)q;
+        q = ja3_list_u16(h->curves, h->curves_len, q);
+
+        h->tja3_ec_point = (const char *)q;
+        q = ja3_list_u8(h->ec_points, h->ec_point_len, q);
+    }
+
+    // There's no compression in SSLv2
+    if ((outputs & SSLHAF_OUTPUT_COMPRESSION)&&(h->hello_version == 3)) {
+        h->compression_methods = (const char *)q;
+
+        for (i = 0; i < h->compression_len; i++) {
+            if (i != 0) {
+                *q++ = ',';
+            }
+
+            q = c2x(h->compression[i], q);
+        }
+
+        *q++ = '\0';
+    }
+
+    if (outputs & SSLHAF_OUTPUT_RAW) {
+        h->client_hello = sslhaf_hex_encode(h->raw, h->raw_len, (char *)q);
+    }
+
+    *u2d(h->hello_version, (unsigned char *)h->thandshake) = '\0';
+    *u2d((unsigned)h->extensions_len, (unsigned char *)h->textensions_len) = '\0';
+
+    *u2d(h->flags, (unsigned char *)h->tflags) = '\0';
+
+    if (h->suite_min_bits >= 0) {
+        *u2d(h->suite_min_bits, (unsigned char *)h->tsuite_min_bits) = '\0';
+    }
+    *u2d((h->protocol_high * 256) + h->protocol_low, (unsigned char *)h->tja3_protocol) = '\0';
+
+    if (outputs & SSLHAF_OUTPUT_JA3) {
+        generate_ja3(h->ja3_hash, h->ja3_digest, h->tja3_protocol,
+            h->tja3_suites, h->tja3_extensions, h->tja3_curves, h->tja3_ec_point);
+    }
+
+    // JA4 is defined for SSLv3 and better only
+    if ((outputs & SSLHAF_OUTPUT_JA4)&&(h->hello_version == 3)) {
+        if (generate_ja4(h) < 0) {
+            return -1;
+        }
+    }
+
+    h->done = 1;
+
+    return 0;
+}
+
+/**
+ * Move the parser on to the next field: an integer (or list item) of
+ * the given size, or a run of bytes to skip.
+ */
+static void parser_expect(sslhaf_parser_t *ps, int stage, size_t need, int skip) {
+    ps->stage = stage;
+    ps->need = need;
+    ps->skip = skip;
+    ps->acc = 0;
+}
+
+/**
+ * Move the parser on to a list of count items of the given size.
+ */
+static void parser_expect_list(sslhaf_parser_t *ps, int stage, size_t count, size_t size) {
+    parser_expect(ps, stage, (count > 0 ? size : 0), 0);
+    ps->count = count;
+}
+
+/**
+ * Move the parser on to the next extension, if there is one. Returns 1
+ * when there are no more extensions, which completes the ClientHello.
+ */
+static int parser_next_extension(sslhaf_parser_t *ps) {
+    if (ps->exts_left == 0) {
+        return 1;
+    }
+
+    if (ps->exts_left < 4) { // extension type and length
+        return -12;
+    }
+
+    ps->exts_left -= 4;
+    parser_expect(ps, PARSE_EXT_TYPE, 2, 0);
+
+    return 0;
+}
+
+/**
+ * Act on a field the parser has just completed, and move it on to the
+ * next one. Returns 0 to carry on, 1 when the ClientHello is complete
+ * and a negative value if the message is malformed.
+ */
+static int parser_field(sslhaf_t *h) {
+    sslhaf_parser_t *ps = &h->parser;
+    uint32_t value = ps->acc;
+
+    switch (ps->stage) {
+    case PARSE_TYPE :
+        // We can only process ClientHello messages
+        if (value != 1) {
+            return 1;
+        }
+
+        parser_expect(ps, PARSE_LENGTH, 3, 0);
+        break;
+
+    case PARSE_LENGTH :
+        // The message may span several records, but we
+        // won't follow it beyond what we're willing to accept
+        if (value + 4 > h->max_record) {
+            sslhaf_error(h, SSLHAF_E_TOO_LONG,
+                "Decoding packet v3 HANDSHAKE: ClientHello too long: %lu; limit %lu",
+                (unsigned long)value, (unsigned long)h->max_record);
+            return -2;
+        }
+
+        if (value < 34) { // for the version number and random value
+            return -3;
+        }
+
+        ps->msg_left = value - 34;
+        parser_expect(ps, PARSE_VERSION, 2, 0);
+        break;
+
+    case PARSE_VERSION :
+        // Use the version number from Client Hello, overriding the
+        // value we got earlier. Some clients will always set the
+        // version number in the Record Layer to TLS 1.0, even if they
+        // support better protocols.
+        h->protocol_high = value >> 8;
+        h->protocol_low = value & 0xff;
+        parser_expect(ps, PARSE_RANDOM, 32, 1);
+        break;
+
+    case PARSE_RANDOM :
+        if (ps->msg_left < 1) { // for the ID length byte
+            return -4;
+        }
+
+        ps->msg_left -= 1;
+        parser_expect(ps, PARSE_ID_LEN, 1, 0);
+        break;
+
+    case PARSE_ID_LEN :
+        if (ps->msg_left < value) { // for the ID
+            return -5;
+        }
+
+        ps->msg_left -= value;
+        parser_expect(ps, PARSE_ID, value, 1);
+        break;
+
+    case PARSE_ID :
+        if (ps->msg_left < 2) { // for the CS length bytes
+            return -6;
+        }
+
+        ps->msg_left -= 2;
+        parser_expect(ps, PARSE_CS_LEN, 2, 0);
+        break;
+
+    case PARSE_CS_LEN :
+        if ((ps->msg_left < value)||(value % 2 != 0)) { // for the suites
+            return -7;
+        }
+
+        ps->msg_left -= value;
+        h->suites = sslhaf_alloc(h, (value / 2) * sizeof(uint32_t));
+        if (h->suites == NULL) {
+            return -15;
+        }
+        parser_expect_list(ps, PARSE_CS, value / 2, 2);
+        break;
+
+    case PARSE_CS :
+    case PARSE_V2_CS :
+        if (ps->count > 0) {
+            const sslhaf_suite_t *suite = sslhaf_suite(value);
+
+            h->suites[h->slen++] = value;
+            ps->count--;
+
+            // Signalling suites only signal; the others tell how
+            // strong the client is willing to go
+            if ((suite != NULL)&&(suite->flags & SSLHAF_SUITE_SCSV)) {
+                if (suite->id == 0xff) {
+                    h->flags |= SSLHAF_FLAG_RENEGOTIATION;
+                }
+            } else if (suite != NULL) {
+                h->flags |= suite->flags;
+
+                if (suite->bits < SSLHAF_WEAK_BITS) {
+                    h->flags |= SSLHAF_FLAG_WEAK;
+                }
+
+                if ((h->suite_min_bits < 0)||(suite->bits < h->suite_min_bits)) {
+                    h->suite_min_bits = suite->bits;
+                }
+            }
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, ps->stage, (ps->stage == PARSE_CS ? 2 : 3), 0);
+        } else if (ps->stage == PARSE_V2_CS) {
+            // That's all we need from SSLv2, but we
+            // skip the rest so that SSLHAF_RAW has it
+            parser_expect(ps, PARSE_V2_REST, ps->msg_left, 1);
+        } else {
+            // Compression
+            if (ps->msg_left < 1) { // compression data length
+                return -8;
+            }
+
+            ps->msg_left -= 1;
+            parser_expect(ps, PARSE_COMP_LEN, 1, 0);
+        }
+        break;
+
+    case PARSE_COMP_LEN :
+        if (ps->msg_left < value) { // compression data
+            return -9;
+        }
+
+        ps->msg_left -= value;
+        h->compression = sslhaf_alloc(h, value);
+        if (h->compression == NULL) {
+            return -15;
+        }
+        parser_expect_list(ps, PARSE_COMP, value, 1);
+        break;
+
+    case PARSE_COMP :
+        if (ps->count > 0) {
+            h->compression[h->compression_len++] = value;
+            ps->count--;
+
+            if (value != 0) {
+                h->flags |= SSLHAF_FLAG_COMPRESSION;
+            }
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, PARSE_COMP, 1, 0);
+            break;
+        }
+
+        // It's OK if there is no more data; that means
+        // we're seeing a handshake without any extensions
+        if (ps->msg_left == 0) {
+            return 1;
+        }
+
+        // Extensions
+        if (ps->msg_left < 2) { // extensions length
+            return -10;
+        }
+
+        ps->msg_left -= 2;
+        parser_expect(ps, PARSE_EXTS_LEN, 2, 0);
+        break;
+
+    case PARSE_EXTS_LEN :
+        if (ps->msg_left < value) { // extension data
+            return -11;
+        }
+
+        ps->msg_left -= value;
+        ps->exts_left = value;
+        h->extension_ids = sslhaf_alloc(h, (value / 4) * sizeof(uint16_t));
+        if (h->extension_ids == NULL) {
+            return -15;
+        }
+
+        return parser_next_extension(ps);
+
+    case PARSE_EXT_TYPE :
+        ps->ext_type = value;
+        h->extension_ids[h->extensions_len++] = value;
+
+        if (value == EXTENSION_SERVER_NAME) {
+            h->sni = 1;
+        } else if (value == EXTENSION_RENEGOTIATION_INFO) {
+            h->flags |= SSLHAF_FLAG_RENEGOTIATION;
+        }
+
+        parser_expect(ps, PARSE_EXT_LEN, 2, 0);
+        break;
+
+    case PARSE_EXT_LEN :
+        if (ps->exts_left < value) { // extension data
+            return -13;
+        }
+
+        ps->exts_left -= value;
+        ps->ext_left = value;
+
+        // Of most extensions we only need the type; but we need
+        // the lists of groups and point formats for JA3, and the
+        // ALPN, signature algorithms and versions for JA4
+        if (!(h->outputs & (SSLHAF_OUTPUT_CURVES|SSLHAF_OUTPUT_JA3|SSLHAF_OUTPUT_JA4))) {
+            // None of the lists are needed
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        } else if ((ps->ext_type == EXTENSION_SUPPORTED_GROUPS)&&(h->curves == NULL)
+            &&(h->outputs & (SSLHAF_OUTPUT_CURVES|SSLHAF_OUTPUT_JA3)))
+        {
+            if (ps->ext_left < 2) {
+                return -14;
+            }
+
+            ps->ext_left -= 2;
+            parser_expect(ps, PARSE_GROUPS_LEN, 2, 0);
+        } else if ((ps->ext_type == EXTENSION_EC_POINT_FORMATS)&&(h->ec_points == NULL)
+            &&(h->outputs & (SSLHAF_OUTPUT_CURVES|SSLHAF_OUTPUT_JA3)))
+        {
+            if (ps->ext_left < 1) {
+                return -14;
+            }
+
+            ps->ext_left -= 1;
+            parser_expect(ps, PARSE_POINTS_LEN, 1, 0);
+        } else if ((ps->ext_type == EXTENSION_ALPN)&&(h->outputs & SSLHAF_OUTPUT_JA4)) {
+            if (ps->ext_left < 2) {
+                return -14;
+            }
+
+            ps->ext_left -= 2;
+            parser_expect(ps, PARSE_ALPN_LEN, 2, 0);
+        } else if ((ps->ext_type == EXTENSION_SIGNATURE_ALGORITHMS)&&(h->sigalgs == NULL)
+            &&(h->outputs & SSLHAF_OUTPUT_JA4))
+        {
+            if (ps->ext_left < 2) {
+                return -14;
+            }
+
+            ps->ext_left -= 2;
+            parser_expect(ps, PARSE_SIGALGS_LEN, 2, 0);
+        } else if ((ps->ext_type == EXTENSION_SUPPORTED_VERSIONS)&&(h->outputs & SSLHAF_OUTPUT_JA4)) {
+            if (ps->ext_left < 1) {
+                return -14;
+            }
+
+            ps->ext_left -= 1;
+            parser_expect(ps, PARSE_VERSIONS_LEN, 1, 0);
+        } else {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        }
+        break;
+
+    case PARSE_GROUPS_LEN :
+        if ((ps->ext_left < value)||(value % 2 != 0)) {
+            return -14;
+        }
+
+        ps->ext_left -= value;
+        h->curves = sslhaf_alloc(h, (value / 2) * sizeof(uint16_t));
+        if (h->curves == NULL) {
+            return -15;
+        }
+        parser_expect_list(ps, PARSE_GROUPS, value / 2, 2);
+        break;
+
+    case PARSE_GROUPS :
+        if (ps->count > 0) {
+            h->curves[h->curves_len++] = value;
+            ps->count--;
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, PARSE_GROUPS, 2, 0);
+        } else {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        }
+        break;
+
+    case PARSE_POINTS_LEN :
+        if (ps->ext_left < value) {
+            return -14;
+        }
+
+        ps->ext_left -= value;
+        h->ec_points = sslhaf_alloc(h, value);
+        if (h->ec_points == NULL) {
+            return -15;
+        }
+        parser_expect_list(ps, PARSE_POINTS, value, 1);
+        break;
+
+    case PARSE_POINTS :
+        if (ps->count > 0) {
+            h->ec_points[h->ec_point_len++] = value;
+            ps->count--;
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, PARSE_POINTS, 1, 0);
+        } else {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        }
+        break;
+
+    case PARSE_ALPN_LEN :
+        if (ps->ext_left < value) {
+            return -14;
+        }
+
+        // Only the first protocol matters
+        if (value == 0) {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+            break;
+        }
+
+        ps->ext_left -= 1;
+        ps->count = value - 1;
+        parser_expect(ps, PARSE_ALPN_NAME_LEN, 1, 0);
+        break;
+
+    case PARSE_ALPN_NAME_LEN :
+        if (ps->count < value) {
+            return -14;
+        }
+
+        ps->ext_left -= value;
+        h->alpn_len = value;
+        parser_expect_list(ps, PARSE_ALPN_NAME, value, 1);
+        break;
+
+    case PARSE_ALPN_NAME :
+        if (ps->count > 0) {
+            if (ps->count == h->alpn_len) {
+                h->alpn_first = value;
+            }
+
+            if (ps->count == 1) {
+                h->alpn_last = value;
+            }
+
+            ps->count--;
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, PARSE_ALPN_NAME, 1, 0);
+        } else {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        }
+        break;
+
+    case PARSE_SIGALGS_LEN :
+        if ((ps->ext_left < value)||(value % 2 != 0)) {
+            return -14;
+        }
+
+        ps->ext_left -= value;
+        h->sigalgs = sslhaf_alloc(h, (value / 2) * sizeof(uint16_t));
+        if (h->sigalgs == NULL) {
+            return -15;
+        }
+        parser_expect_list(ps, PARSE_SIGALGS, value / 2, 2);
+        break;
+
+    case PARSE_SIGALGS :
+        if (ps->count > 0) {
+            h->sigalgs[h->sigalgs_len++] = value;
+            ps->count--;
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, PARSE_SIGALGS, 2, 0);
+        } else {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        }
+        break;
+
+    case PARSE_VERSIONS_LEN :
+        if ((ps->ext_left < value)||(value % 2 != 0)) {
+            return -14;
+        }
+
+        ps->ext_left -= value;
+        parser_expect_list(ps, PARSE_VERSIONS, value / 2, 2);
+        break;
+
+    case PARSE_VERSIONS :
+        if (ps->count > 0) {
+            if ((!IS_GREASE(value))&&(value > h->supported_version)) {
+                h->supported_version = value;
+            }
+
+            ps->count--;
+        }
+
+        if (ps->count > 0) {
+            parser_expect(ps, PARSE_VERSIONS, 2, 0);
+        } else {
+            parser_expect(ps, PARSE_EXT_DATA, ps->ext_left, 1);
+        }
+        break;
+
+    case PARSE_EXT_DATA :
+        ps->ext_left = 0;
+        return parser_next_extension(ps);
+
+    // SSLv2 ClientHello: there are 6 bytes before the list of
+    // cipher suites: cipher suite length (2 bytes), session ID
+    // length (2 bytes) and challenge length (2 bytes).
+    case PARSE_V2_CS_LEN :
+        if (ps->msg_left < 6) {
+            return -1;
+        }
+
+        ps->msg_left -= 6;
+
+        // Check that we have the suites in the packet
+        if (ps->msg_left < value) {
+            return -2;
+        }
+
+        // In SSLv2 each suite consumes 3 bytes
+        if (value % 3 != 0) {
+            return -16;
+        }
+
+        ps->msg_left -= value;
+        ps->count = value / 3;
+        parser_expect(ps, PARSE_V2_ID_LEN, 2, 0);
+        break;
+
+    case PARSE_V2_ID_LEN :
+        parser_expect(ps, PARSE_V2_CH_LEN, 2, 0);
+        break;
+
+    case PARSE_V2_CH_LEN :
+        h->suites = sslhaf_alloc(h, ps->count * sizeof(uint32_t));
+        if (h->suites == NULL) {
+            return -15;
+        }
+        parser_expect_list(ps, PARSE_V2_CS, ps->count, 3);
+        break;
+
+    case PARSE_V2_REST :
+        return 1;
+
+    default :
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Feed bytes of the packet body to the ClientHello parser. The number
+ * of bytes used is stored in used; it's less than len only when the
+ * ClientHello ended before the data did. Returns 0 when more data is
+ * needed, 1 when the ClientHello is complete (or the packet does not
+ * contain one) and a negative value on error.
+ */
+static int parser_feed(sslhaf_t *h,
+    const unsigned char *p, size_t len, size_t *used)
+{
+    sslhaf_parser_t *ps = &h->parser;
+    const unsigned char *end = p + len;
+    const unsigned char *start = p;
+    int rc = 0;
+
+    for(;;) {
+        // Fields (and empty lists) are complete when
+        // there are no more bytes to read for them
+        if (ps->need == 0) {
+            rc = parser_field(h);
+            if (rc != 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (p == end) {
+            break;
+        }
+
+        if (ps->skip) {
+            size_t n = (ps->need < (size_t)(end - p)) ? ps->need : (size_t)(end - p);
+            p += n;
+            ps->need -= n;
+        } else {
+            ps->acc = (ps->acc << 8) | *p++;
+            ps->need--;
+        }
+    }
+
+    *used = p - start;
+
+    return rc;
+}
+
+/**
+ * Make room for len more bytes of the raw packet. The ClientHello
+ * usually arrives in a single record, for which this allocates
+ * exactly once; the buffer doubles for the records that follow.
+ * Returns -1 if memory runs out.
+ */
+static int raw_reserve(sslhaf_t *h, size_t len) {
+    unsigned char *raw;
+    size_t size;
+
+    if (h->raw_len + len <= h->raw_size) {
+        return 0;
+    }
+
+    size = h->raw_size * 2;
+    if (size < h->raw_len + len) {
+        size = h->raw_len + len;
+    }
+
+    raw = sslhaf_alloc(h, size);
+    if (raw == NULL) {
+        return -1;
+    }
+
+    if (h->raw_len > 0) {
+        memcpy(raw, h->raw, h->raw_len);
+    }
+
+    h->raw = raw;
+    h->raw_size = size;
+
+    return 0;
+}
+
+/**
+ * Give up on the connection.
+ */
+static int sslhaf_goaway(sslhaf_t *h, int rc) {
+    h->state = SSLHAF_STATE_GOAWAY;
+
+    return rc;
+}
+
+void sslhaf_init(sslhaf_t *h, unsigned int outputs, size_t max_record,
+    sslhaf_alloc_fn alloc, void *alloc_ctx)
+{
+    memset(h, 0, sizeof(*h));
+
+    h->state = SSLHAF_STATE_START;
+    h->outputs = outputs;
+    h->max_record = ((max_record > 0)&&(max_record < SSLHAF_HELLO_LIMIT))
+        ? max_record : SSLHAF_HELLO_LIMIT;
+    h->alloc = alloc;
+    h->alloc_ctx = alloc_ctx;
+    h->suite_min_bits = -1;
+}
+
+/**
+ * We look for a handshake SSL packet and parse the ClientHello in it
+ * as the bytes arrive, possibly across several invocations and several
+ * records.
+ */
+int sslhaf_feed(sslhaf_t *h, const unsigned char *inputbuf, size_t inputlen) {
+    // Loop while there's input to process
+    while(inputlen > 0) {
+        if (h->state == SSLHAF_STATE_GOAWAY) {
+            return SSLHAF_DONE;
+        }
+        
+        // Are we expecting a handshake packet?
+        if (h->state == SSLHAF_STATE_START) {
+            // An SSLv2 record header has the top bit set
+            if ((inputbuf[0] != PROTOCOL_HANDSHAKE)&&(!(inputbuf[0] & 0x80))) {
+                sslhaf_error(h, SSLHAF_E_NOT_SSL,
+                    "First byte (%d) of this connection does not indicate SSL; skipping",
+                    inputbuf[0]);
+                return sslhaf_goaway(h, SSLHAF_NOT_SSL);
+            }
+
+            h->state = SSLHAF_STATE_HEADER;
+            h->header_len = 0;
+        }
+
+        // Collect the packet header, which may straddle buckets. Both
+        // SSLv3+ records and SSLv2 ClientHello start with 5 bytes we need
+        if (h->state == SSLHAF_STATE_HEADER) {
+            size_t len;
+
+            while ((h->header_len < sizeof(h->header))&&(inputlen > 0)) {
+                h->header[h->header_len++] = *inputbuf++;
+                inputlen--;
+            }
+
+            if (h->header_len < sizeof(h->header)) {
+                return SSLHAF_AGAIN;
+            }
+
+            if (h->hello_records > 0) {
+                // A continuation of the ClientHello, which
+                // can only be another handshake record
+                if (h->header[0] != PROTOCOL_HANDSHAKE) {
+                    sslhaf_error(h, SSLHAF_E_RECORD_TYPE, "Unexpected record type %d in ClientHello",
+                        h->header[0]);
+                    return sslhaf_goaway(h, SSLHAF_ERROR);
+                }
+
+                len = (h->header[3] * 256) + h->header[4];
+            } else if (h->header[0] == PROTOCOL_HANDSHAKE) {
+                h->hello_version = 3;
+                // Remember the protocol version used, but only if we don't already have it
+                if (h->protocol_high == 0) {
+                    h->protocol_high = h->header[1];
+                    h->protocol_low = h->header[2];
+                }
+
+                // Calculate packet length
+                len = (h->header[3] * 256) + h->header[4];
+
+                parser_expect(&h->parser, PARSE_TYPE, 1, 0);
+            } else {
+                // Check that it is indeed ClientHello
+                if (h->header[2] != 1) {
+                    sslhaf_error(h, SSLHAF_E_NOT_V2_HELLO, "Not SSLv2 ClientHello (%d)", h->header[2]);
+                    return sslhaf_goaway(h, SSLHAF_ERROR);
+                }
+
+                h->hello_version = 2;
+
+                if ((h->header[3] == 0x00)&&(h->header[4] == 0x02)) {
+                    // SSL v2 uses 0x0002 for the version number
+                    h->protocol_high = h->header[4];
+                    h->protocol_low = h->header[3];
+                } else {
+                    // SSL v3 will use 0x0300, 0x0301, etc.
+                    h->protocol_high = h->header[3];
+                    h->protocol_low = h->header[4];
+                }
+
+                // The length has 15 bits, and we've already
+                // consumed 3 bytes from the packet
+                len = ((h->header[0] & 0x7f) * 256) + h->header[1];
+                len = (len >= 3) ? len - 3 : 0;
+
+                parser_expect(&h->parser, PARSE_V2_CS_LEN, 2, 0);
+                h->parser.msg_left = len;
+            }
+
+            if (len == 0) {
+                sslhaf_error(h, SSLHAF_E_EMPTY_RECORD, "Empty TLS record");
+                return sslhaf_goaway(h, SSLHAF_ERROR);
+            }
+
+            // Limit what we are willing to accept
+            h->hello_records++;
+            h->hello_bytes += len;
+
+            if ((h->hello_records > SSLHAF_HELLO_RECORDS)||(h->hello_bytes > h->max_record)) {
+                sslhaf_error(h, SSLHAF_E_TOO_LONG,
+                    "ClientHello too long: %u records, %lu bytes; limit %d records, %lu bytes",
+                    h->hello_records, (unsigned long)h->hello_bytes, SSLHAF_HELLO_RECORDS,
+                    (unsigned long)h->max_record);
+                return sslhaf_goaway(h, SSLHAF_ERROR);
+            }
+
+            // The packet is kept, headers included, for SSLHAF_OUTPUT_RAW
+            if (h->outputs & (SSLHAF_OUTPUT_RAW|SSLHAF_OUTPUT_PACKET)) {
+                if (raw_reserve(h, sizeof(h->header) + len) < 0) {
+                    sslhaf_error(h, SSLHAF_E_NOMEM, "Out of memory");
+                    return sslhaf_goaway(h, SSLHAF_ERROR);
+                }
+
+                memcpy(h->raw + h->raw_len, h->header, sizeof(h->header));
+                h->raw_len += sizeof(h->header);
+            }
+
+            // Parse the rest of the packet as it arrives
+            h->state = SSLHAF_STATE_PARSING;
+            h->buf_to_go = len;
+        }
+
+        if (h->state == SSLHAF_STATE_PARSING) {
+            size_t len = (h->buf_to_go < inputlen) ? h->buf_to_go : inputlen;
+            size_t used = 0;
+            int rc;
+
+            rc = parser_feed(h, inputbuf, len, &used);
+
+            if (h->outputs & (SSLHAF_OUTPUT_RAW|SSLHAF_OUTPUT_PACKET)) {
+                memcpy(h->raw + h->raw_len, inputbuf, used);
+                h->raw_len += used;
+            }
+
+            h->buf_to_go -= used;
+            inputbuf += used;
+            inputlen -= used;
+
+            if ((rc == 0)&&(h->buf_to_go == 0)) {
+                if (h->hello_version == 3) {
+                    // The ClientHello continues in the next record
+                    h->state = SSLHAF_STATE_HEADER;
+                    h->header_len = 0;
+                    continue;
+                }
+
+                // The packet ended before the ClientHello did
+                rc = -2;
+            }
+
+            if (rc != 0) {
+                // Stop following this connection; we're only interested in
+                // ClientHello, which is always the first client message.
+                h->state = SSLHAF_STATE_GOAWAY;
+
+                if ((rc > 0)&&(h->suites != NULL)&&(finish_fingerprint(h) < 0)) {
+                    rc = -15;
+                }
+
+                if (rc < 0) {
+                    if (rc == -15) {
+                        sslhaf_error(h, SSLHAF_E_NOMEM, "Out of memory");
+                    }
+
+                    h->decode_rc = rc;
+                    sslhaf_error(h, SSLHAF_E_DECODE, "Packet decoding error rc %d (hello %d)",
+                        rc, h->hello_version);
+                    return SSLHAF_ERROR;
+                }
+
+                return SSLHAF_DONE;
+            }
+        }
+    }
+    
+    return (h->state == SSLHAF_STATE_GOAWAY) ? SSLHAF_DONE : SSLHAF_AGAIN;
+}
+
+size_t sslhaf_message_header(int hello_version, const unsigned char *record_version,
+    size_t len, unsigned char *header)
+{
+    if (hello_version == 2) {
+        // The 2-byte form of the SSLv2 record header: the top bit
+        // set, then a 15-bit length
+        if ((len < 3)||(len > 0x7fff)) {
+            return 0;
+        }
+
+        header[0] = 0x80 | (len >> 8);
+        header[1] = len & 0xff;
+
+        return 2;
+    }
+
+    if ((len < 4)||(len > 0xffff)) {
+        return 0;
+    }
+
+    header[0] = PROTOCOL_HANDSHAKE;
+    header[1] = (record_version != NULL) ? record_version[0] : 3;
+    header[2] = (record_version != NULL) ? record_version[1] : 1;
+    header[3] = len >> 8;
+    header[4] = len & 0xff;
+
+    return 5;
+}
+
+void *sslhaf_arena_alloc(void *ctx, size_t size) {
+    sslhaf_arena_t *arena = ctx;
+    void *p;
+
+    // Keep allocations aligned for the arrays of integers
+    size = (size + 7) & ~(size_t)7;
+
+    if (size > arena->size - arena->used) {
+        return NULL;
+    }
+
+    p = arena->base + arena->used;
+    arena->used += size;
+
+    return p;
+}
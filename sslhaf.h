@@ -0,0 +1,380 @@
+/*
+
+libsslhaf: passive SSL client fingerprinting
+ 
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * The sslhaf library: the ClientHello parser and the fingerprints
+ * computed from it, independent of any server. It's what mod_sslhaf
+ * uses inside Apache, and what sslhaf_offline uses on captured traffic.
+ *
+ * The caller owns the memory. A sslhaf_t, initialised with sslhaf_init(),
+ * holds the state of one connection; everything else (the lists the
+ * client offers and the strings written out at the end) comes from the
+ * allocator the caller supplies, in a handful of blocks that are all
+ * bounded by the size of the ClientHello. Nothing is freed by the
+ * library: drop the allocator's memory once the results aren't needed.
+ * The allocator can be a pool, or an arena from sslhaf_arena_alloc().
+ *
+ * Feed the bytes the client sends, in chunks of any size, to
+ * sslhaf_feed() until it no longer returns SSLHAF_AGAIN:
+ *
+ *     sslhaf_t h;
+ *
+ *     sslhaf_init(&h, SSLHAF_OUTPUT_ALL, SSLHAF_HELLO_LIMIT, alloc, ctx);
+ *     while ((rc = sslhaf_feed(&h, data, len)) == SSLHAF_AGAIN) {
+ *         ... read more data ...
+ *     }
+ *
+ *     if (h.done) {
+ *         ... use h.ja3_hash, h.ja4 and the other results ...
+ *     }
+ */
+
+#ifndef SSLHAF_H
+#define SSLHAF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* What sslhaf_feed() returns: more data is needed, or we're done with
+ * the connection (whether or not it had a ClientHello to fingerprint),
+ * or the data is not SSL, or it's malformed, which is described in
+ * the error member. */
+#define SSLHAF_AGAIN        0
+#define SSLHAF_DONE         1
+#define SSLHAF_NOT_SSL      -1
+#define SSLHAF_ERROR        -2
+
+/* Why sslhaf_feed() gave up, in error_code: the data is not SSL, a
+ * record of the ClientHello is of the wrong type, the SSLv2 message is
+ * not a ClientHello, a record is empty, the ClientHello is longer than
+ * the limit, memory ran out, or the ClientHello is malformed. */
+#define SSLHAF_E_NOT_SSL        1
+#define SSLHAF_E_RECORD_TYPE    2
+#define SSLHAF_E_NOT_V2_HELLO   3
+#define SSLHAF_E_EMPTY_RECORD   4
+#define SSLHAF_E_TOO_LONG       5
+#define SSLHAF_E_NOMEM          6
+#define SSLHAF_E_DECODE         7
+#define SSLHAF_E_MAX            7
+
+/* The ClientHello parser fails with one of these many codes, from -1
+ * to -SSLHAF_DECODE_CODES, in decode_rc. */
+#define SSLHAF_DECODE_CODES     15
+
+/* The results to compute. Only the work the requested outputs need is
+ * done; the others are left NULL or empty. */
+#define SSLHAF_OUTPUT_SUITES        0x01
+#define SSLHAF_OUTPUT_COMPRESSION   0x02
+#define SSLHAF_OUTPUT_EXTENSIONS    0x04
+#define SSLHAF_OUTPUT_CURVES        0x08
+#define SSLHAF_OUTPUT_JA3           0x10
+#define SSLHAF_OUTPUT_JA4           0x20
+#define SSLHAF_OUTPUT_RAW           0x40
+#define SSLHAF_OUTPUT_ALL           0x7f
+
+/* Keep the packet in raw, as with SSLHAF_OUTPUT_RAW, but don't encode
+ * it as hex; for callers that store the bytes themselves. */
+#define SSLHAF_OUTPUT_PACKET        0x80
+
+/* A ClientHello may be split across several records, which we
+ * reassemble. We follow at most SSLHAF_HELLO_RECORDS of them, and at
+ * most SSLHAF_HELLO_LIMIT bytes of record data in total (or less, as
+ * given to sslhaf_init()), which is what bounds the memory we use for
+ * a connection. */
+#define SSLHAF_HELLO_LIMIT      65536
+#define SSLHAF_HELLO_RECORDS    16
+
+#define SSLHAF_MD5_DIGESTSIZE   16
+
+/* A JA4 fingerprint is "t13d1516h2_8daaf6152771_e5627efa2ab1". */
+#define SSLHAF_JA4_LEN          36
+
+/* Inspection state. */
+#define SSLHAF_STATE_START      0
+#define SSLHAF_STATE_HEADER     1
+#define SSLHAF_STATE_PARSING    2
+#define SSLHAF_STATE_GOAWAY     3
+
+/* What is known about a cipher suite, from suites.csv: its name, the
+ * size of its key in bits, and these flags. A signalling suite, such as
+ * TLS_EMPTY_RENEGOTIATION_INFO_SCSV, has only SSLHAF_SUITE_SCSV. */
+#define SSLHAF_SUITE_RC4        0x01
+#define SSLHAF_SUITE_EXPORT     0x02
+#define SSLHAF_SUITE_NULL       0x04
+#define SSLHAF_SUITE_ANON       0x08
+#define SSLHAF_SUITE_SCSV       0x10
+
+typedef struct sslhaf_suite_t {
+    const char *name;
+    uint32_t id;
+    unsigned short bits;
+    unsigned short flags;
+} sslhaf_suite_t;
+
+/* What the ClientHello says about the client's security, worked out as
+ * the suites, compression methods and extensions arrive: it offers
+ * suites with RC4, export, NULL or anonymous key exchange (known from
+ * their flags, which have the same values), or with keys of fewer than
+ * 128 bits; it supports secure renegotiation (the renegotiation_info
+ * extension or TLS_EMPTY_RENEGOTIATION_INFO_SCSV); it offers a
+ * compression method other than NULL. */
+#define SSLHAF_FLAG_RC4             SSLHAF_SUITE_RC4
+#define SSLHAF_FLAG_EXPORT          SSLHAF_SUITE_EXPORT
+#define SSLHAF_FLAG_NULL            SSLHAF_SUITE_NULL
+#define SSLHAF_FLAG_ANON            SSLHAF_SUITE_ANON
+#define SSLHAF_FLAG_WEAK            0x10
+#define SSLHAF_FLAG_RENEGOTIATION   0x20
+#define SSLHAF_FLAG_COMPRESSION     0x40
+
+#define SSLHAF_WEAK_BITS            128
+
+/* Allocates size bytes, or returns NULL. */
+typedef void *(*sslhaf_alloc_fn)(void *ctx, size_t size);
+
+/* The ClientHello parser. It is fed the bytes of the message as they
+ * arrive and keeps just enough state to carry on where it stopped; the
+ * bytes themselves are never buffered. Every field is either an integer
+ * of "need" bytes, which is accumulated in acc, or a run of "need" bytes
+ * to skip. List items are integers too, with count items still to go.
+ * The *_left members hold how much of the enclosing message, extension
+ * block and extension remains, so that every length the client declares
+ * is checked against what encloses it before we act on it. */
+typedef struct sslhaf_parser_t {
+    int stage;
+    int skip;
+    size_t need;
+    uint32_t acc;
+    size_t count;
+    size_t msg_left;
+    size_t exts_left;
+    size_t ext_left;
+    unsigned int ext_type;
+} sslhaf_parser_t;
+
+typedef struct sslhaf_t {
+    /* Inspection state; see above for the constants. */
+    int state;
+
+    /* Set once the ClientHello has been fingerprinted. */
+    int done;
+
+    /* The outputs to compute and the record data limit. */
+    unsigned int outputs;
+    size_t max_record;
+
+    /* Where memory comes from. */
+    sslhaf_alloc_fn alloc;
+    void *alloc_ctx;
+
+    /* The header of the current SSL packet, collected byte by byte
+     * because it can straddle buckets, and the number of bytes of
+     * the packet that we're still expecting. */
+    unsigned char header[5];
+    size_t header_len;
+    size_t buf_to_go;
+
+    /* How many records the ClientHello has arrived in so far, and
+     * their total length, headers excluded. */
+    unsigned int hello_records;
+    size_t hello_bytes;
+
+    /* The ClientHello parser. */
+    sslhaf_parser_t parser;
+    
+    /* The client hello version used; 2 or 3. */
+    unsigned int hello_version;
+    
+    /* SSL version indicated in the handshake. */
+    unsigned int protocol_high;
+    unsigned int protocol_low;
+    
+    /* The suites, extension types, supported groups and EC point
+     * formats offered by the client, in the order they were sent, as
+     * collected by the parser. A v2 suite takes 3 bytes, hence 32 bits
+     * per suite. The arrays are allocated as soon as the client
+     * declares the length of each list. */
+    size_t slen;
+    uint32_t *suites;
+    uint16_t *extension_ids;
+    size_t curves_len;
+    uint16_t *curves;
+    size_t ec_point_len;
+    unsigned char *ec_points;
+    unsigned char *compression;
+
+    /* Of the suites offered that sslhaf_suite() knows, the smallest
+     * key size (signalling suites aside), or -1 if there are none. */
+    int suite_min_bits;
+
+    /* SSLHAF_FLAG_* values; see above. */
+    unsigned int flags;
+
+    /* The packet (all the records of it) as received, headers
+     * included, for SSLHAF_OUTPUT_RAW and SSLHAF_OUTPUT_PACKET, and
+     * the size of the buffer. */
+    unsigned char *raw;
+    size_t raw_len;
+    size_t raw_size;
+    
+    /* Handkshake version as string. */
+    char thandshake[4];
+
+    /* How many compression methods are there. */    
+    size_t compression_len;
+
+    /* List of all compression methods as a comma-separated string. */    
+    const char *compression_methods;
+    
+    /* How many extensions were there in the handshake? */
+    size_t extensions_len;
+
+    /* Number of extensions as string. */
+    char textensions_len[12];
+
+    /* suite_min_bits as string; empty if it's -1. */
+    char tsuite_min_bits[12];
+
+    /* Flags, in decimal, as string. */
+    char tflags[12];
+
+    /* The entire raw handshake packet, consisting of a record layer packet with a
+     * Client Hello inside it. Encoded as a string of hexadecimal characters. */    
+    const char *client_hello;
+
+    /* JA3 fields, in decimal with GREASE values removed. List elements
+     * are separated with dashes. The fields whose size is fixed are
+     * kept here; the lists are written into one allocated block once
+     * the ClientHello is complete. */
+    char tja3_protocol[8];
+    const char *tja3_suites;
+    const char *tja3_extensions;
+    const char *tja3_curves;
+    const char *tja3_ec_point;
+
+    /* MD5 of the JA3 string, as hex, and in binary form. */
+    char ja3_hash[(SSLHAF_MD5_DIGESTSIZE * 2) + 1];
+    unsigned char ja3_digest[SSLHAF_MD5_DIGESTSIZE];
+
+    /* What JA4 needs besides the above: whether the client sent SNI,
+     * the first ALPN protocol (its length and its first and last byte),
+     * the signature algorithms in the order they were sent, and the
+     * highest version in supported_versions (0 if there wasn't one). */
+    int sni;
+    size_t alpn_len;
+    unsigned char alpn_first;
+    unsigned char alpn_last;
+    size_t sigalgs_len;
+    uint16_t *sigalgs;
+    unsigned int supported_version;
+
+    /* The JA4 fingerprint; empty for SSLv2 ClientHello. */
+    char ja4[SSLHAF_JA4_LEN + 1];
+
+    /* Why sslhaf_feed() failed: an SSLHAF_E_* value (0 if it didn't),
+     * the code the parser failed with (0 if it didn't), and a
+     * description for the error log. */
+    int error_code;
+    int decode_rc;
+    char error[160];
+} sslhaf_t;
+
+/* A simple arena for sslhaf_arena_alloc(): one block of memory that
+ * allocations are carved from. Reset used to 0 to reuse it. */
+typedef struct sslhaf_arena_t {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+} sslhaf_arena_t;
+
+/**
+ * Prepare h for a new connection.
+ */
+void sslhaf_init(sslhaf_t *h, unsigned int outputs, size_t max_record,
+    sslhaf_alloc_fn alloc, void *alloc_ctx);
+
+/**
+ * Feed the next len bytes the client sent. Returns SSLHAF_AGAIN while
+ * more data is needed; any other value means we're done with this
+ * connection. Once the ClientHello has been parsed, done is set and the
+ * requested results are available.
+ */
+int sslhaf_feed(sslhaf_t *h, const unsigned char *data, size_t len);
+
+/**
+ * Write the record header to feed in front of a ClientHello that was
+ * handed over as one message, without the records it came in, as
+ * OpenSSL's message callback does: the 5-byte header of a handshake
+ * record with the given version (3.1 if NULL) when hello_version is 3,
+ * or the 2-byte header of an SSLv2 record when it's 2. header must
+ * have room for 5 bytes. Returns the length of the header, or 0 if the
+ * message can't be a ClientHello in a single record.
+ */
+size_t sslhaf_message_header(int hello_version, const unsigned char *record_version,
+    size_t len, unsigned char *header);
+
+/**
+ * An allocator, for sslhaf_init(), that takes memory from the
+ * sslhaf_arena_t given as ctx.
+ */
+void *sslhaf_arena_alloc(void *ctx, size_t size);
+
+/**
+ * Write the hexadecimal representation of the input bytes, followed
+ * by a NUL, into a buffer of at least (len * 2) + 1 bytes.
+ */
+char *sslhaf_hex_encode(const unsigned char *data, size_t len, char *hex);
+
+/**
+ * Convert a string of hexadecimal characters back into len bytes.
+ * Returns -1 if the string has anything other than hex digits.
+ */
+int sslhaf_hex_decode(const char *hex, size_t len, unsigned char *data);
+
+/**
+ * Look up a cipher suite by its ID (3 bytes for SSLv2 suites). Returns
+ * NULL if it isn't in suites.csv.
+ */
+const sslhaf_suite_t *sslhaf_suite(uint32_t id);
+
+/**
+ * Look up the name of an extension by its type. Returns NULL if it
+ * isn't in extensions.csv.
+ */
+const char *sslhaf_extension_name(unsigned int type);
+
+#endif /* SSLHAF_H */
@@ -0,0 +1,309 @@
+/*
+
+mod_sslhaf: Apache module for passive SSL client fingerprinting
+
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * sslhaf_collector receives the records mod_sslhaf sends to its export
+ * socket (SSLHAFExportSocket): it binds a Unix datagram socket at the
+ * given path, replacing whatever is there, and takes one or more whole
+ * records from each datagram.
+ *
+ * For every record it prints one line with tab-separated fields: the
+ * time (seconds and microseconds since the epoch), the client address,
+ * the handshake version, the JA3 hash and the size of the ClientHello.
+ * With -w, the records are appended to a binary log instead, in the
+ * format of SSLHAFBinaryLog, which sslhaf_offline reads.
+ *
+ * To compile:
+ *
+ *     $ cc -O2 -o sslhaf_collector sslhaf_collector.c
+ *
+ * Usage:
+ *
+ *     $ sslhaf_collector [-w file] socket_path
+ *
+ * It runs until interrupted, then removes the socket and prints a
+ * summary to stderr. The socket must be writable by the user the
+ * server processes run as.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "sslhaf.h"
+
+#define BINLOG_MAGIC        "SSLHAFB1"
+#define BINLOG_FORMAT       1
+#define BINLOG_HEADER_LEN   48
+
+/* A datagram holds a batch of at most 64 KB, or a single record, which
+ * can be larger. */
+#define COLLECTOR_MAX_DATAGRAM  (BINLOG_HEADER_LEN + SSLHAF_HELLO_LIMIT \
+    + (SSLHAF_HELLO_RECORDS * 5) + (64 * 1024))
+#define COLLECTOR_RCVBUF        (1024 * 1024)
+
+static volatile sig_atomic_t stopping = 0;
+
+static struct {
+    unsigned long datagrams;
+    unsigned long records;
+    unsigned long invalid;
+    unsigned long long bytes;
+} stats;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stopping = 1;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * Print a record.
+ */
+static void print_record(const unsigned char *record, uint32_t len) {
+    static const char digits[] = "0123456789abcdef";
+    char addr[INET6_ADDRSTRLEN];
+    char ja3[(16 * 2) + 1];
+    uint64_t t = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        t = (t << 8) | record[8 + i];
+    }
+
+    if ((record[6] != 4)&&(record[6] != 6)) {
+        strcpy(addr, "-");
+    } else {
+        inet_ntop((record[6] == 6) ? AF_INET6 : AF_INET, record + 16, addr, sizeof(addr));
+    }
+
+    for (i = 0; i < 16; i++) {
+        ja3[i * 2] = digits[record[32 + i] >> 4];
+        ja3[(i * 2) + 1] = digits[record[32 + i] & 0x0f];
+    }
+
+    ja3[32] = '\0';
+
+    printf("%llu.%06llu\t%s\t%u\t%s\t%u\n", (unsigned long long)(t / 1000000),
+        (unsigned long long)(t % 1000000), addr, record[7], ja3,
+        (unsigned int)(len - BINLOG_HEADER_LEN));
+}
+
+/**
+ * Split a datagram into records and print or write them. Whatever
+ * doesn't look like a record ends the datagram.
+ */
+static void process_datagram(const unsigned char *data, size_t len, FILE *out) {
+    size_t off = 0;
+
+    stats.datagrams++;
+
+    while (off < len) {
+        uint32_t record_len;
+
+        if (len - off < BINLOG_HEADER_LEN) {
+            stats.invalid++;
+            return;
+        }
+
+        record_len = get_u32(data + off);
+        if ((record_len < BINLOG_HEADER_LEN)||(record_len > len - off)
+            ||(data[off + 5] != BINLOG_FORMAT))
+        {
+            stats.invalid++;
+            return;
+        }
+
+        if (out != NULL) {
+            if (fwrite(data + off, 1, record_len, out) != record_len) {
+                perror("sslhaf_collector: write");
+                stopping = 1;
+                return;
+            }
+        } else {
+            print_record(data + off, record_len);
+        }
+
+        stats.records++;
+        stats.bytes += record_len - BINLOG_HEADER_LEN;
+        off += record_len;
+    }
+}
+
+/**
+ * Open the binary log to append to, starting it with the magic number
+ * if it's new. Returns NULL on error.
+ */
+static FILE *open_binlog(const char *filename) {
+    struct stat st;
+    FILE *f;
+
+    f = fopen(filename, "ab");
+    if (f == NULL) {
+        perror(filename);
+        return NULL;
+    }
+
+    if (fstat(fileno(f), &st) < 0) {
+        perror(filename);
+        fclose(f);
+        return NULL;
+    }
+
+    if ((st.st_size == 0)&&(fwrite(BINLOG_MAGIC, 1, 8, f) != 8)) {
+        perror(filename);
+        fclose(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+int main(int argc, char **argv) {
+    const char *filename = NULL;
+    struct sockaddr_un addr;
+    struct sigaction sa;
+    unsigned char *data;
+    FILE *out = NULL;
+    int c, sock, size = COLLECTOR_RCVBUF;
+
+    while ((c = getopt(argc, argv, "w:")) != -1) {
+        switch (c) {
+            case 'w' :
+                filename = optarg;
+                break;
+
+            default :
+                fprintf(stderr, "Usage: sslhaf_collector [-w file] socket_path\n");
+                return 2;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "Usage: sslhaf_collector [-w file] socket_path\n");
+        return 2;
+    }
+
+    if (strlen(argv[optind]) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "sslhaf_collector: Socket path too long: %s\n", argv[optind]);
+        return 1;
+    }
+
+    data = malloc(COLLECTOR_MAX_DATAGRAM);
+    if (data == NULL) {
+        fprintf(stderr, "sslhaf_collector: Out of memory\n");
+        return 1;
+    }
+
+    if (filename != NULL) {
+        out = open_binlog(filename);
+        if (out == NULL) {
+            return 1;
+        }
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, argv[optind]);
+
+    sock = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("sslhaf_collector: socket");
+        return 1;
+    }
+
+    // Room for bursts from many server processes at once
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    unlink(addr.sun_path);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror(addr.sun_path);
+        return 1;
+    }
+
+    // Not SA_RESTART, so that recv() returns when we're to stop
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    while (!stopping) {
+        ssize_t len = recv(sock, data, COLLECTOR_MAX_DATAGRAM, 0);
+
+        if (len < 0) {
+            if (errno != EINTR) {
+                perror("sslhaf_collector: recv");
+                break;
+            }
+
+            continue;
+        }
+
+        process_datagram(data, len, out);
+
+        // Records are written as they come, for tail -f
+        fflush((out != NULL) ? out : stdout);
+    }
+
+    unlink(addr.sun_path);
+    close(sock);
+
+    if ((out != NULL)&&(fclose(out) != 0)) {
+        perror(filename);
+    }
+
+    fprintf(stderr, "sslhaf_collector: %lu datagrams, %lu records (%llu bytes), %lu invalid\n",
+        stats.datagrams, stats.records, stats.bytes, stats.invalid);
+
+    free(data);
+
+    return 0;
+}
@@ -0,0 +1,961 @@
+/*
+
+mod_sslhaf: Apache module for passive SSL client fingerprinting
+
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * sslhaf_offline fingerprints SSL clients outside the server, using the
+ * same library as mod_sslhaf. It reads, from the files named on the
+ * command line or from standard input:
+ *
+ * - packet captures in the pcap format (not pcapng), with Ethernet, Linux
+ *   cooked, BSD loopback or raw IP link layers. TCP over IPv4 and IPv6 is
+ *   followed per connection, in sequence order; segments that arrive
+ *   ahead of a gap are ignored, as are IP fragments.
+ *
+ * - SSLHAF_RAW values, one per line, as logged by the module. Empty
+ *   lines, lines starting with # and "-" (no value) are skipped.
+ *
+ * - binary logs written by the module (SSLHAFBinaryLog).
+ *
+ * - the raw bytes a single client sent, as a file that starts with an
+ *   SSL record.
+ *
+ * For every ClientHello it prints one line with tab-separated fields:
+ * where it came from (client and server address, or file and line),
+ * the handshake version, the protocol version, the JA3 hash and the
+ * JA4 fingerprint ("-" when not computed). A summary goes to stderr.
+ *
+ * To compile:
+ *
+ *     $ cc -O2 -o sslhaf_offline sslhaf_offline.c sslhaf.c
+ *
+ * Usage:
+ *
+ *     $ sslhaf_offline [-o outputs] [-v] [file ...]
+ *
+ * where outputs is a comma-separated list of the names SSLHAFOutputs
+ * takes; the default is "ja3,ja4". With -v, the reasons for the
+ * handshakes that could not be fingerprinted go to stderr.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sslhaf.h"
+
+#define PCAP_MAGIC          0xa1b2c3d4
+#define PCAP_MAGIC_NSEC     0xa1b23c4d
+#define PCAP_MAX_PACKET     (256 * 1024)
+
+#define BINLOG_MAGIC        "SSLHAFB1"
+#define BINLOG_HEADER_LEN   48
+
+#define LINKTYPE_NULL       0
+#define LINKTYPE_ETHERNET   1
+#define LINKTYPE_RAW        101
+#define LINKTYPE_LINUX_SLL  113
+
+#define TCP_FIN             0x01
+#define TCP_SYN             0x02
+#define TCP_RST             0x04
+#define TCP_ACK             0x10
+
+#define FLOW_BUCKETS        65536
+
+/* Where a source's bytes are to go. */
+#define FLOW_ACTIVE         0
+#define FLOW_FINISHED       1
+#define FLOW_SERVER         2
+
+/* Memory for one connection: a list of blocks, each one allocation,
+ * all freed together once the connection is done with. */
+typedef union sslhaf_block_t {
+    union sslhaf_block_t *next;
+    long double align;
+} sslhaf_block_t;
+
+typedef struct sslhaf_mem_t {
+    sslhaf_block_t *blocks;
+} sslhaf_mem_t;
+
+/* One direction of a TCP connection. */
+typedef struct sslhaf_flow_t {
+    struct sslhaf_flow_t *next;
+
+    int family;
+    unsigned char src[16];
+    unsigned char dst[16];
+    uint16_t sport;
+    uint16_t dport;
+
+    int state;
+
+    /* The sequence number of the next byte we expect, once known. */
+    int seq_known;
+    uint32_t next_seq;
+
+    sslhaf_t hello;
+    sslhaf_mem_t mem;
+} sslhaf_flow_t;
+
+typedef struct sslhaf_stats_t {
+    unsigned long packets;
+    unsigned long flows;
+    unsigned long hellos;
+    unsigned long failed;
+    unsigned long skipped;
+    unsigned long long bytes;
+} sslhaf_stats_t;
+
+static sslhaf_flow_t *flows[FLOW_BUCKETS];
+static sslhaf_stats_t stats;
+static unsigned int outputs = SSLHAF_OUTPUT_JA3 | SSLHAF_OUTPUT_JA4;
+static int verbose = 0;
+
+static const struct {
+    const char *name;
+    unsigned int flags;
+} sslhaf_outputs[] = {
+    { "suites", SSLHAF_OUTPUT_SUITES },
+    { "compression", SSLHAF_OUTPUT_COMPRESSION },
+    { "extensions", SSLHAF_OUTPUT_EXTENSIONS },
+    { "curves", SSLHAF_OUTPUT_CURVES },
+    { "ja3", SSLHAF_OUTPUT_JA3 },
+    { "ja4", SSLHAF_OUTPUT_JA4 },
+    { "raw", SSLHAF_OUTPUT_RAW },
+    { "all", SSLHAF_OUTPUT_ALL },
+    { NULL, 0 }
+};
+
+/**
+ * Allocator for the library, from a connection's block list.
+ */
+static void *mem_alloc(void *ctx, size_t size) {
+    sslhaf_mem_t *mem = ctx;
+    sslhaf_block_t *b;
+
+    b = malloc(sizeof(sslhaf_block_t) + size);
+    if (b == NULL) {
+        return NULL;
+    }
+
+    b->next = mem->blocks;
+    mem->blocks = b;
+
+    return b + 1;
+}
+
+/**
+ * Free everything allocated for a connection.
+ */
+static void mem_free(sslhaf_mem_t *mem) {
+    while (mem->blocks != NULL) {
+        sslhaf_block_t *b = mem->blocks;
+        mem->blocks = b->next;
+        free(b);
+    }
+}
+
+/**
+ * Print the fingerprints of a ClientHello, or why there are none.
+ * The handshake is done with afterwards.
+ */
+static void report(const char *source, sslhaf_t *h, int rc) {
+    if (h->done) {
+        stats.hellos++;
+        printf("%s\t%s\t%u.%u\t%s\t%s\n", source, h->thandshake,
+            h->protocol_high, h->protocol_low,
+            (outputs & SSLHAF_OUTPUT_JA3) ? h->ja3_hash : "-",
+            h->ja4[0] != '\0' ? h->ja4 : "-");
+        return;
+    }
+
+    stats.failed++;
+
+    if (verbose) {
+        fprintf(stderr, "sslhaf_offline: %s: %s\n", source,
+            rc == SSLHAF_AGAIN ? "Incomplete ClientHello" : h->error);
+    }
+}
+
+/**
+ * Describe the client and the server of a flow.
+ */
+static void flow_source(const sslhaf_flow_t *flow, char *buf, size_t len) {
+    char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+
+    inet_ntop(flow->family, flow->src, src, sizeof(src));
+    inet_ntop(flow->family, flow->dst, dst, sizeof(dst));
+
+    if (flow->family == AF_INET6) {
+        snprintf(buf, len, "[%s]:%u>[%s]:%u", src, flow->sport, dst, flow->dport);
+    } else {
+        snprintf(buf, len, "%s:%u>%s:%u", src, flow->sport, dst, flow->dport);
+    }
+}
+
+static unsigned int flow_hash(int family, const unsigned char *src,
+    const unsigned char *dst, uint16_t sport, uint16_t dport)
+{
+    uint32_t h = 2166136261u;
+    size_t alen = (family == AF_INET6) ? 16 : 4;
+    size_t i;
+
+    // FNV-1a over the 4-tuple
+    for (i = 0; i < alen; i++) {
+        h = (h ^ src[i]) * 16777619u;
+        h = (h ^ dst[i]) * 16777619u;
+    }
+
+    h = (h ^ sport) * 16777619u;
+    h = (h ^ dport) * 16777619u;
+
+    return h % FLOW_BUCKETS;
+}
+
+/**
+ * Find a flow, creating it if asked to. Returns NULL when the flow
+ * does not exist and create is 0, or when out of memory.
+ */
+static sslhaf_flow_t *flow_find(int family, const unsigned char *src,
+    const unsigned char *dst, uint16_t sport, uint16_t dport, int create)
+{
+    unsigned int bucket = flow_hash(family, src, dst, sport, dport);
+    size_t alen = (family == AF_INET6) ? 16 : 4;
+    sslhaf_flow_t *flow;
+
+    for (flow = flows[bucket]; flow != NULL; flow = flow->next) {
+        if ((flow->family == family)&&(flow->sport == sport)&&(flow->dport == dport)
+            &&(memcmp(flow->src, src, alen) == 0)&&(memcmp(flow->dst, dst, alen) == 0))
+        {
+            return flow;
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    flow = calloc(1, sizeof(sslhaf_flow_t));
+    if (flow == NULL) {
+        return NULL;
+    }
+
+    flow->family = family;
+    memcpy(flow->src, src, alen);
+    memcpy(flow->dst, dst, alen);
+    flow->sport = sport;
+    flow->dport = dport;
+    sslhaf_init(&flow->hello, outputs, SSLHAF_HELLO_LIMIT, mem_alloc, &flow->mem);
+
+    flow->next = flows[bucket];
+    flows[bucket] = flow;
+    stats.flows++;
+
+    return flow;
+}
+
+/**
+ * Forget a flow, when its connection is closed.
+ */
+static void flow_remove(sslhaf_flow_t *flow) {
+    unsigned int bucket = flow_hash(flow->family, flow->src, flow->dst,
+        flow->sport, flow->dport);
+    sslhaf_flow_t **p;
+
+    for (p = &flows[bucket]; *p != NULL; p = &(*p)->next) {
+        if (*p == flow) {
+            *p = flow->next;
+            break;
+        }
+    }
+
+    mem_free(&flow->mem);
+    free(flow);
+}
+
+/**
+ * Report the connections that ended before their ClientHello was
+ * complete, and free all flows.
+ */
+static void flow_flush(void) {
+    char source[128];
+    size_t i;
+
+    for (i = 0; i < FLOW_BUCKETS; i++) {
+        while (flows[i] != NULL) {
+            sslhaf_flow_t *flow = flows[i];
+
+            if ((flow->state == FLOW_ACTIVE)&&(flow->hello.state != SSLHAF_STATE_START)) {
+                flow_source(flow, source, sizeof(source));
+                report(source, &flow->hello, SSLHAF_AGAIN);
+            }
+
+            flows[i] = flow->next;
+            mem_free(&flow->mem);
+            free(flow);
+        }
+    }
+}
+
+/**
+ * Feed the payload of a TCP segment to its flow.
+ */
+static void process_tcp(int family, const unsigned char *src,
+    const unsigned char *dst, const unsigned char *data, size_t len)
+{
+    sslhaf_flow_t *flow;
+    uint16_t sport, dport;
+    uint32_t seq, offset;
+    unsigned int flags;
+    size_t hlen;
+    char source[128];
+    int rc;
+
+    if (len < 20) {
+        return;
+    }
+
+    sport = (data[0] << 8) | data[1];
+    dport = (data[2] << 8) | data[3];
+    seq = ((uint32_t)data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+    hlen = (data[12] >> 4) * 4;
+    flags = data[13];
+
+    if ((hlen < 20)||(hlen > len)) {
+        return;
+    }
+
+    data += hlen;
+    len -= hlen;
+
+    if (flags & TCP_SYN) {
+        // A SYN starts a connection: the side that sends it without
+        // ACK is the client, and the reverse direction is the server's
+        flow = flow_find(family, src, dst, sport, dport, 1);
+        if (flow == NULL) {
+            return;
+        }
+
+        if (flow->hello.state != SSLHAF_STATE_START) {
+            // A new connection on the same ports
+            flow_remove(flow);
+            flow = flow_find(family, src, dst, sport, dport, 1);
+            if (flow == NULL) {
+                return;
+            }
+        }
+
+        flow->state = (flags & TCP_ACK) ? FLOW_SERVER : FLOW_ACTIVE;
+        flow->seq_known = 1;
+        flow->next_seq = seq + 1;
+
+        return;
+    }
+
+    flow = flow_find(family, src, dst, sport, dport, len != 0);
+    if (flow == NULL) {
+        return;
+    }
+
+    if (flags & (TCP_FIN | TCP_RST)) {
+        if ((len == 0)||(flow->state != FLOW_ACTIVE)) {
+            if ((flow->state == FLOW_ACTIVE)&&(flow->hello.state != SSLHAF_STATE_START)) {
+                flow_source(flow, source, sizeof(source));
+                report(source, &flow->hello, SSLHAF_AGAIN);
+            }
+
+            flow_remove(flow);
+
+            return;
+        }
+    }
+
+    if ((flow->state != FLOW_ACTIVE)||(len == 0)) {
+        return;
+    }
+
+    // Without the SYN in the capture, start from the first data we see
+    if (!flow->seq_known) {
+        flow->seq_known = 1;
+        flow->next_seq = seq;
+    }
+
+    // Use only what continues the stream: skip what we've seen before,
+    // and ignore segments that are ahead of a gap
+    offset = flow->next_seq - seq;
+    if (offset >= len) {
+        if ((int32_t)offset < 0) {
+            stats.skipped++;
+        }
+
+        return;
+    }
+
+    data += offset;
+    len -= offset;
+    flow->next_seq += len;
+
+    rc = sslhaf_feed(&flow->hello, data, len);
+    if (rc == SSLHAF_AGAIN) {
+        return;
+    }
+
+    flow_source(flow, source, sizeof(source));
+
+    if ((rc == SSLHAF_NOT_SSL)&&(!verbose)) {
+        stats.failed++;
+    } else {
+        report(source, &flow->hello, rc);
+    }
+
+    // Keep the flow, but not its memory, so that what follows
+    // the ClientHello is not mistaken for a new connection
+    flow->state = FLOW_FINISHED;
+    mem_free(&flow->mem);
+
+    if (flags & (TCP_FIN | TCP_RST)) {
+        flow_remove(flow);
+    }
+}
+
+/**
+ * Find the TCP segment in an IP packet.
+ */
+static void process_ip(const unsigned char *data, size_t len) {
+    unsigned int next;
+    size_t hlen, total;
+
+    if (len < 1) {
+        return;
+    }
+
+    if ((data[0] >> 4) == 4) {
+        if (len < 20) {
+            return;
+        }
+
+        hlen = (data[0] & 0x0f) * 4;
+        total = (data[2] << 8) | data[3];
+
+        // Fragments (more to come, or not the first) are not reassembled
+        if ((data[9] != 6)||(((data[6] << 8) | data[7]) & 0x3fff)) {
+            return;
+        }
+
+        // The link layer may pad the packet
+        if ((hlen < 20)||(total < hlen)||(total > len)) {
+            return;
+        }
+
+        process_tcp(AF_INET, data + 12, data + 16, data + hlen, total - hlen);
+    }
+    else if ((data[0] >> 4) == 6) {
+        if (len < 40) {
+            return;
+        }
+
+        total = 40 + ((data[4] << 8) | data[5]);
+        if (total > len) {
+            return;
+        }
+
+        // Skip the extension headers that may come before TCP
+        next = data[6];
+        hlen = 40;
+        while ((next == 0)||(next == 43)||(next == 60)) {
+            if (hlen + 8 > total) {
+                return;
+            }
+
+            next = data[hlen];
+            hlen += (data[hlen + 1] + 1) * 8;
+        }
+
+        if ((next != 6)||(hlen > total)) {
+            return;
+        }
+
+        process_tcp(AF_INET6, data + 8, data + 24, data + hlen, total - hlen);
+    }
+}
+
+/**
+ * Find the IP packet in a captured frame.
+ */
+static void process_frame(unsigned int linktype, int swapped,
+    const unsigned char *data, size_t len)
+{
+    unsigned int ethertype;
+    uint32_t family;
+
+    switch (linktype) {
+        case LINKTYPE_NULL :
+            // The address family, in the byte order of the host
+            // that made the capture; IPv6 has several values
+            if (len < 4) {
+                return;
+            }
+
+            memcpy(&family, data, 4);
+            if (swapped) {
+                family = ((family & 0xff) << 24) | ((family & 0xff00) << 8)
+                    | ((family >> 8) & 0xff00) | (family >> 24);
+            }
+
+            if ((family == 2)||(family == 24)||(family == 28)||(family == 30)) {
+                process_ip(data + 4, len - 4);
+            }
+            break;
+
+        case LINKTYPE_ETHERNET :
+            if (len < 14) {
+                return;
+            }
+
+            ethertype = (data[12] << 8) | data[13];
+            data += 14;
+            len -= 14;
+
+            // VLAN tags
+            while (((ethertype == 0x8100)||(ethertype == 0x88a8))&&(len >= 4)) {
+                ethertype = (data[2] << 8) | data[3];
+                data += 4;
+                len -= 4;
+            }
+
+            if ((ethertype == 0x0800)||(ethertype == 0x86dd)) {
+                process_ip(data, len);
+            }
+            break;
+
+        case LINKTYPE_RAW :
+            process_ip(data, len);
+            break;
+
+        case LINKTYPE_LINUX_SLL :
+            if (len < 16) {
+                return;
+            }
+
+            ethertype = (data[14] << 8) | data[15];
+            if ((ethertype == 0x0800)||(ethertype == 0x86dd)) {
+                process_ip(data + 16, len - 16);
+            }
+            break;
+    }
+}
+
+static uint32_t pcap_u32(const unsigned char *p, int swapped) {
+    if (swapped) {
+        return ((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+    }
+
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+ * Read a pcap file, whose magic number has already been read
+ * into header. Returns -1 on error.
+ */
+static int process_pcap(const char *name, FILE *f, unsigned char *header, int swapped) {
+    unsigned char rec[16];
+    unsigned char *packet;
+    unsigned int linktype;
+    uint32_t caplen;
+
+    if (fread(header + 4, 1, 20, f) != 20) {
+        fprintf(stderr, "sslhaf_offline: %s: Truncated pcap header\n", name);
+        return -1;
+    }
+
+    linktype = pcap_u32(header + 20, swapped) & 0xffff;
+    if ((linktype != LINKTYPE_NULL)&&(linktype != LINKTYPE_ETHERNET)
+        &&(linktype != LINKTYPE_RAW)&&(linktype != LINKTYPE_LINUX_SLL))
+    {
+        fprintf(stderr, "sslhaf_offline: %s: Unsupported link type %u\n", name, linktype);
+        return -1;
+    }
+
+    packet = malloc(PCAP_MAX_PACKET);
+    if (packet == NULL) {
+        fprintf(stderr, "sslhaf_offline: Out of memory\n");
+        return -1;
+    }
+
+    while (fread(rec, 1, 16, f) == 16) {
+        caplen = pcap_u32(rec + 8, swapped);
+        if (caplen > PCAP_MAX_PACKET) {
+            fprintf(stderr, "sslhaf_offline: %s: Packet too large (%u bytes)\n",
+                name, (unsigned int)caplen);
+            free(packet);
+            return -1;
+        }
+
+        if (fread(packet, 1, caplen, f) != caplen) {
+            break;
+        }
+
+        stats.packets++;
+        stats.bytes += caplen;
+
+        process_frame(linktype, swapped, packet, caplen);
+    }
+
+    free(packet);
+
+    return 0;
+}
+
+/**
+ * Read SSLHAF_RAW values, one per line. The first bytes of the
+ * file have already been read into prefix.
+ */
+static int process_hex(const char *name, FILE *f, const unsigned char *prefix, size_t plen) {
+    char *line = NULL;
+    size_t size = 0, len = 0, i;
+    unsigned char *data;
+    unsigned int lineno = 0;
+    char source[256];
+    int c, eof = 0;
+
+    while (!eof) {
+        // Read a line, starting with what was already read
+        len = 0;
+
+        for (;;) {
+            if (plen > 0) {
+                c = *prefix++;
+                plen--;
+            } else {
+                c = getc(f);
+            }
+
+            if (c == EOF) {
+                eof = 1;
+                break;
+            }
+
+            if (c == '\n') {
+                break;
+            }
+
+            if (len + 1 >= size) {
+                char *n = realloc(line, size ? size * 2 : 4096);
+                if (n == NULL) {
+                    fprintf(stderr, "sslhaf_offline: Out of memory\n");
+                    free(line);
+                    return -1;
+                }
+
+                line = n;
+                size = size ? size * 2 : 4096;
+            }
+
+            line[len++] = c;
+        }
+
+        lineno++;
+
+        while ((len > 0)&&((line[len - 1] == '\r')||(line[len - 1] == ' ')
+            ||(line[len - 1] == '\t')))
+        {
+            len--;
+        }
+
+        for (i = 0; (i < len)&&((line[i] == ' ')||(line[i] == '\t')); i++);
+
+        if ((i == len)||(line[i] == '#')||(line[i] == '-')) {
+            continue;
+        }
+
+        snprintf(source, sizeof(source), "%s:%u", name, lineno);
+
+        if ((len - i) % 2 != 0) {
+            stats.failed++;
+            if (verbose) {
+                fprintf(stderr, "sslhaf_offline: %s: Odd number of hex digits\n", source);
+            }
+            continue;
+        }
+
+        // The hex is at least as long as the data, so decode in place
+        data = (unsigned char *)line;
+        if (sslhaf_hex_decode(line + i, (len - i) / 2, data) < 0) {
+            stats.failed++;
+            if (verbose) {
+                fprintf(stderr, "sslhaf_offline: %s: Invalid hex digit\n", source);
+            }
+            continue;
+        }
+
+        {
+            sslhaf_mem_t mem = { NULL };
+            sslhaf_t h;
+            int rc;
+
+            stats.packets++;
+            stats.bytes += (len - i) / 2;
+
+            sslhaf_init(&h, outputs, SSLHAF_HELLO_LIMIT, mem_alloc, &mem);
+            rc = sslhaf_feed(&h, data, (len - i) / 2);
+            report(source, &h, rc);
+            mem_free(&mem);
+        }
+    }
+
+    free(line);
+
+    return 0;
+}
+
+/**
+ * Read a binary log written by the module, whose first 8 bytes (the
+ * magic number) have already been read. Returns -1 on error.
+ */
+static int process_binlog(const char *name, FILE *f) {
+    unsigned char header[BINLOG_HEADER_LEN];
+    unsigned char *data;
+    char addr[INET6_ADDRSTRLEN];
+    uint32_t len;
+
+    data = malloc(SSLHAF_HELLO_LIMIT + (SSLHAF_HELLO_RECORDS * 5));
+    if (data == NULL) {
+        fprintf(stderr, "sslhaf_offline: Out of memory\n");
+        return -1;
+    }
+
+    while (fread(header, 1, BINLOG_HEADER_LEN, f) == BINLOG_HEADER_LEN) {
+        sslhaf_mem_t mem = { NULL };
+        sslhaf_t h;
+        int rc;
+
+        len = pcap_u32(header, 0);
+        if ((len < BINLOG_HEADER_LEN)||(len - BINLOG_HEADER_LEN > SSLHAF_HELLO_LIMIT
+            + (SSLHAF_HELLO_RECORDS * 5)))
+        {
+            fprintf(stderr, "sslhaf_offline: %s: Invalid record length %u\n",
+                name, (unsigned int)len);
+            free(data);
+            return -1;
+        }
+
+        len -= BINLOG_HEADER_LEN;
+        if (fread(data, 1, len, f) != len) {
+            break;
+        }
+
+        inet_ntop((header[6] == 6) ? AF_INET6 : AF_INET, header + 16, addr, sizeof(addr));
+
+        stats.packets++;
+        stats.bytes += len;
+
+        sslhaf_init(&h, outputs, SSLHAF_HELLO_LIMIT, mem_alloc, &mem);
+        rc = sslhaf_feed(&h, data, len);
+        report(addr, &h, rc);
+        mem_free(&mem);
+    }
+
+    free(data);
+
+    return 0;
+}
+
+/**
+ * Read what one client sent, as is. The first bytes of the
+ * file have already been read into prefix.
+ */
+static int process_raw(const char *name, FILE *f, const unsigned char *prefix, size_t plen) {
+    unsigned char buf[16384];
+    sslhaf_mem_t mem = { NULL };
+    sslhaf_t h;
+    size_t len;
+    int rc;
+
+    sslhaf_init(&h, outputs, SSLHAF_HELLO_LIMIT, mem_alloc, &mem);
+
+    stats.packets++;
+    stats.bytes += plen;
+
+    rc = sslhaf_feed(&h, prefix, plen);
+    while ((rc == SSLHAF_AGAIN)&&((len = fread(buf, 1, sizeof(buf), f)) > 0)) {
+        stats.bytes += len;
+        rc = sslhaf_feed(&h, buf, len);
+    }
+
+    report(name, &h, rc);
+    mem_free(&mem);
+
+    return 0;
+}
+
+/**
+ * Work out what a file holds from its first bytes, and read it.
+ */
+static int process_file(const char *name, FILE *f) {
+    unsigned char header[24];
+    uint32_t magic;
+    size_t len;
+
+    len = fread(header, 1, 4, f);
+    if (len < 4) {
+        return process_hex(name, f, header, len);
+    }
+
+    magic = pcap_u32(header, 0);
+
+    if ((magic == PCAP_MAGIC)||(magic == PCAP_MAGIC_NSEC)) {
+        return process_pcap(name, f, header, 0);
+    }
+
+    magic = pcap_u32(header, 1);
+
+    if ((magic == PCAP_MAGIC)||(magic == PCAP_MAGIC_NSEC)) {
+        return process_pcap(name, f, header, 1);
+    }
+
+    if (memcmp(header, BINLOG_MAGIC, 4) == 0) {
+        len += fread(header + 4, 1, 4, f);
+        if ((len == 8)&&(memcmp(header, BINLOG_MAGIC, 8) == 0)) {
+            return process_binlog(name, f);
+        }
+
+        return process_hex(name, f, header, len);
+    }
+
+    // An SSLv3+ handshake record, or an SSLv2 record header
+    if ((header[0] == 0x16)||(header[0] & 0x80)) {
+        return process_raw(name, f, header, len);
+    }
+
+    return process_hex(name, f, header, len);
+}
+
+static int parse_outputs(char *arg) {
+    char *name, *save = NULL;
+    int i;
+
+    outputs = 0;
+
+    for (name = strtok_r(arg, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save)) {
+        for (i = 0; sslhaf_outputs[i].name != NULL; i++) {
+            if (strcasecmp(name, sslhaf_outputs[i].name) == 0) {
+                outputs |= sslhaf_outputs[i].flags;
+                break;
+            }
+        }
+
+        if (sslhaf_outputs[i].name == NULL) {
+            fprintf(stderr, "sslhaf_offline: Unknown output: %s\n", name);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct timespec start, end;
+    double elapsed;
+    int c, i, rc = 0;
+
+    while ((c = getopt(argc, argv, "o:v")) != -1) {
+        switch (c) {
+            case 'o' :
+                if (parse_outputs(optarg) < 0) {
+                    return 2;
+                }
+                break;
+
+            case 'v' :
+                verbose = 1;
+                break;
+
+            default :
+                fprintf(stderr, "Usage: sslhaf_offline [-o outputs] [-v] [file ...]\n");
+                return 2;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (optind == argc) {
+        if (process_file("-", stdin) < 0) {
+            rc = 1;
+        }
+    }
+
+    for (i = optind; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL) {
+            fprintf(stderr, "sslhaf_offline: %s: %s\n", argv[i], strerror(errno));
+            rc = 1;
+            continue;
+        }
+
+        if (process_file(argv[i], f) < 0) {
+            rc = 1;
+        }
+
+        fclose(f);
+        flow_flush();
+    }
+
+    flow_flush();
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (elapsed <= 0) {
+        elapsed = 1e-9;
+    }
+
+    fprintf(stderr, "sslhaf_offline: %lu packets, %lu connections, %lu ClientHellos, "
+        "%lu not fingerprinted, %lu out-of-order segments skipped; "
+        "%.3f s, %.0f ClientHellos/s, %.1f MB/s\n",
+        stats.packets, stats.flows, stats.hellos, stats.failed, stats.skipped,
+        elapsed, stats.hellos / elapsed, stats.bytes / elapsed / 1e6);
+
+    return rc;
+}
@@ -0,0 +1,228 @@
+# sslhaf_tables.awk: generates sslhaf_tables.h, the cipher suite and
+# extension tables of the sslhaf library, from suites.csv and
+# extensions.csv. From the top directory:
+#
+#     $ awk -f sslhaf_tables.awk suites.csv extensions.csv > sslhaf_tables.h
+#
+# Run it again, and commit the result, whenever either file changes.
+#
+# suites.csv has a line per suite: name, ID (0x followed by 2 hex digits,
+# or 6 for SSLv2), key size in bits and the group the suite comes from.
+# extensions.csv has the name and ID of each extension. Empty lines and
+# lines that start with # are skipped. When an ID appears more than once,
+# the last line wins.
+#
+# A suite or extension is found with two loads: the high byte of the ID
+# picks a page of 256 entries, the low byte the entry in it. Only pages
+# that have something in them are generated. SSLv2 suites, of which there
+# are a handful, are in a list of their own.
+
+BEGIN {
+    FS = ","
+    digits = "0123456789abcdef"
+}
+
+/^#/ || /^[ \t\r]*$/ {
+    next
+}
+
+{
+    sub(/\r$/, "")
+
+    if ((NF < 2)||($2 !~ /^0x[0-9a-fA-F]+$/)) {
+        printf("sslhaf_tables.awk: %s:%d: Invalid line\n", FILENAME, FNR) > "/dev/stderr"
+        failed = 1
+        exit 1
+    }
+
+    id = hex($2)
+}
+
+FILENAME == ARGV[1] {
+    if ((NF != 4)||($3 !~ /^[0-9]+$/)) {
+        printf("sslhaf_tables.awk: %s:%d: Invalid line\n", FILENAME, FNR) > "/dev/stderr"
+        failed = 1
+        exit 1
+    }
+
+    if (!(id in suite_name)) {
+        suite_ids[nsuites++] = id
+    }
+
+    suite_name[id] = $1
+    suite_bits[id] = $3
+    next
+}
+
+FILENAME == ARGV[2] {
+    if (id > 65535) {
+        printf("sslhaf_tables.awk: %s:%d: Invalid ID\n", FILENAME, FNR) > "/dev/stderr"
+        failed = 1
+        exit 1
+    }
+
+    if (!(id in ext_name)) {
+        ext_ids[nexts++] = id
+    }
+
+    ext_name[id] = $1
+    next
+}
+
+END {
+    if (failed) {
+        exit 1
+    }
+
+    sort(suite_ids, nsuites)
+    sort(ext_ids, nexts)
+
+    print "/*"
+    print " * Generated by sslhaf_tables.awk from suites.csv and extensions.csv;"
+    print " * don't edit. See sslhaf_tables.awk for how to regenerate it."
+    print " */"
+    print ""
+
+    # SSLv2 suites first, then the others, ordered by ID
+    nv2 = 0
+    for (i = 0; i < nsuites; i++) {
+        if (suite_ids[i] > 65535) {
+            order[nv2++] = suite_ids[i]
+        }
+    }
+
+    n = nv2
+    for (i = 0; i < nsuites; i++) {
+        if (suite_ids[i] <= 65535) {
+            order[n++] = suite_ids[i]
+        }
+    }
+
+    printf("#define SUITES_V2 %d\n\n", nv2)
+
+    print "static const sslhaf_suite_t suite_table[] = {"
+    for (i = 0; i < n; i++) {
+        id = order[i]
+        printf("    { \"%s\", 0x%s, %d, %s },\n", suite_name[id],
+            tohex(id, (id > 65535) ? 6 : 4), suite_bits[id], flags(suite_name[id], suite_bits[id]))
+
+        if (id <= 65535) {
+            suite_slot[id] = i + 1
+        }
+    }
+    print "};"
+    print ""
+
+    pages("suite", suite_slot, "unsigned short")
+
+    print "static const char * const extension_table[] = {"
+    for (i = 0; i < nexts; i++) {
+        printf("    \"%s\",\n", ext_name[ext_ids[i]])
+        ext_slot[ext_ids[i]] = i + 1
+    }
+    print "};"
+    print ""
+
+    pages("extension", ext_slot, "unsigned char")
+}
+
+# Write the page of each high byte, plus one (0 if it has none), and
+# the pages, with the index into the table of each entry, plus one.
+function pages(prefix, slot, type,    high, low, npages, page_of, line, i, id) {
+    npages = 0
+
+    for (high = 0; high < 256; high++) {
+        page_of[high] = 0
+
+        for (low = 0; low < 256; low++) {
+            if (((high * 256) + low) in slot) {
+                page_of[high] = ++npages
+                break
+            }
+        }
+    }
+
+    printf("static const unsigned char %s_pages[256] = {\n", prefix)
+    for (high = 0; high < 256; high += 16) {
+        line = "   "
+        for (low = 0; low < 16; low++) {
+            line = line " " page_of[high + low] ","
+        }
+        print line
+    }
+    print "};"
+    print ""
+
+    printf("static const %s %s_index[%d][256] = {\n", type, prefix, npages)
+    for (high = 0; high < 256; high++) {
+        if (page_of[high] == 0) {
+            continue
+        }
+
+        printf("    /* 0x%s00 */\n    {\n", tohex(high, 2))
+        for (low = 0; low < 256; low += 16) {
+            line = "       "
+            for (i = 0; i < 16; i++) {
+                id = (high * 256) + low + i
+                line = line " " ((id in slot) ? slot[id] : 0) ","
+            }
+            print line
+        }
+        print "    },"
+    }
+    print "};"
+    print ""
+}
+
+# The flags of a suite, from what its name says.
+function flags(name, bits,    f) {
+    f = ""
+
+    if (name ~ /_SCSV$/) {
+        return "SSLHAF_SUITE_SCSV"
+    }
+
+    if (name ~ /_RC4_/) f = f "|SSLHAF_SUITE_RC4"
+    if (name ~ /EXPORT/) f = f "|SSLHAF_SUITE_EXPORT"
+    if (bits == 0) f = f "|SSLHAF_SUITE_NULL"
+    if ((name ~ /_anon_/)||(name ~ /^TLS_NULL_WITH/)) f = f "|SSLHAF_SUITE_ANON"
+
+    return (f == "") ? "0" : substr(f, 2)
+}
+
+function hex(s,    i, v) {
+    s = tolower(substr(s, 3))
+    v = 0
+
+    for (i = 1; i <= length(s); i++) {
+        v = (v * 16) + index(digits, substr(s, i, 1)) - 1
+    }
+
+    return v
+}
+
+function tohex(v, width,    s) {
+    s = ""
+
+    while (v > 0) {
+        s = substr(digits, (v % 16) + 1, 1) s
+        v = int(v / 16)
+    }
+
+    while (length(s) < width) {
+        s = "0" s
+    }
+
+    return s
+}
+
+# Insertion sort; the lists are short.
+function sort(a, n,    i, j, v) {
+    for (i = 1; i < n; i++) {
+        v = a[i]
+        for (j = i - 1; (j >= 0)&&(a[j] > v); j--) {
+            a[j + 1] = a[j]
+        }
+        a[j + 1] = v
+    }
+}
@@ -0,0 +1,515 @@
+/*
+ * Generated by sslhaf_tables.awk from suites.csv and extensions.csv;
+ * don't edit. See sslhaf_tables.awk for how to regenerate it.
+ */
+
+#define SUITES_V2 8
+
+static const sslhaf_suite_t suite_table[] = {
+    { "SSL_RC4_128_WITH_MD5", 0x010080, 128, SSLHAF_SUITE_RC4 },
+    { "SSL_RC4_128_EXPORT40_WITH_MD5", 0x020080, 40, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "SSL_RC2_128_CBC_WITH_MD5", 0x030080, 128, 0 },
+    { "SSL_RC2_128_CBC_EXPORT40_WITH_MD5", 0x040080, 40, SSLHAF_SUITE_EXPORT },
+    { "SSL_IDEA_128_CBC_WITH_MD5", 0x050080, 128, 0 },
+    { "SSL_DES_64_CBC_WITH_MD5", 0x060040, 56, 0 },
+    { "SSL_DES_192_EDE3_CBC_WITH_MD5", 0x0700c0, 168, 0 },
+    { "SSL_CK_RC4_64_WITH_MD5", 0x080080, 64, SSLHAF_SUITE_RC4 },
+    { "TLS_NULL_WITH_NULL_NULL", 0x0000, 0, SSLHAF_SUITE_NULL|SSLHAF_SUITE_ANON },
+    { "TLS_RSA_WITH_NULL_MD5", 0x0001, 0, SSLHAF_SUITE_NULL },
+    { "TLS_RSA_WITH_NULL_SHA", 0x0002, 0, SSLHAF_SUITE_NULL },
+    { "TLS_RSA_EXPORT_WITH_RC4_40_MD5", 0x0003, 40, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "TLS_RSA_WITH_RC4_128_MD5", 0x0004, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_RSA_WITH_RC4_128_SHA", 0x0005, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_RSA_EXPORT_WITH_RC2_CBC_40_MD5", 0x0006, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_RSA_WITH_IDEA_CBC_SHA", 0x0007, 128, 0 },
+    { "TLS_RSA_EXPORT_WITH_DES40_CBC_SHA", 0x0008, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_RSA_WITH_DES_CBC_SHA", 0x0009, 56, 0 },
+    { "TLS_RSA_WITH_3DES_EDE_CBC_SHA", 0x000a, 168, 0 },
+    { "TLS_DH_DSS_EXPORT_WITH_DES40_CBC_SHA", 0x000b, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_DH_DSS_WITH_DES_CBC_SHA", 0x000c, 56, 0 },
+    { "TLS_DH_DSS_WITH_3DES_EDE_CBC_SHA", 0x000d, 168, 0 },
+    { "TLS_DH_RSA_EXPORT_WITH_DES40_CBC_SHA", 0x000e, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_DH_RSA_WITH_DES_CBC_SHA", 0x000f, 56, 0 },
+    { "TLS_DH_RSA_WITH_3DES_EDE_CBC_SHA", 0x0010, 168, 0 },
+    { "TLS_DHE_DSS_EXPORT_WITH_DES40_CBC_SHA", 0x0011, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_DHE_DSS_WITH_DES_CBC_SHA", 0x0012, 56, 0 },
+    { "TLS_DHE_DSS_WITH_3DES_EDE_CBC_SHA", 0x0013, 168, 0 },
+    { "TLS_DHE_RSA_EXPORT_WITH_DES40_CBC_SHA", 0x0014, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_DHE_RSA_WITH_DES_CBC_SHA", 0x0015, 56, 0 },
+    { "TLS_DHE_RSA_WITH_3DES_EDE_CBC_SHA", 0x0016, 168, 0 },
+    { "TLS_DH_anon_EXPORT_WITH_RC4_40_MD5", 0x0017, 40, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT|SSLHAF_SUITE_ANON },
+    { "TLS_DH_anon_WITH_RC4_128_MD5", 0x0018, 128, SSLHAF_SUITE_RC4|SSLHAF_SUITE_ANON },
+    { "TLS_DH_anon_EXPORT_WITH_DES40_CBC_SHA", 0x0019, 40, SSLHAF_SUITE_EXPORT|SSLHAF_SUITE_ANON },
+    { "TLS_DH_anon_WITH_DES_CBC_SHA", 0x001a, 56, SSLHAF_SUITE_ANON },
+    { "TLS_DH_anon_WITH_3DES_EDE_CBC_SHA", 0x001b, 168, SSLHAF_SUITE_ANON },
+    { "SSL_FORTEZZA_KEA_WITH_NULL_SHA", 0x001c, 0, SSLHAF_SUITE_NULL },
+    { "SSL_FORTEZZA_KEA_WITH_FORTEZZA_CBC_SHA", 0x001d, 96, 0 },
+    { "TLS_KRB5_WITH_DES_CBC_SHA", 0x001e, 56, 0 },
+    { "TLS_KRB5_WITH_3DES_EDE_CBC_SHA", 0x001f, 168, 0 },
+    { "TLS_KRB5_WITH_RC4_128_SHA", 0x0020, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_KRB5_WITH_IDEA_CBC_SHA", 0x0021, 128, 0 },
+    { "TLS_KRB5_WITH_DES_CBC_MD5", 0x0022, 56, 0 },
+    { "TLS_KRB5_WITH_3DES_EDE_CBC_MD5", 0x0023, 168, 0 },
+    { "TLS_KRB5_WITH_RC4_128_MD5", 0x0024, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_KRB5_WITH_IDEA_CBC_MD5", 0x0025, 128, 0 },
+    { "TLS_KRB5_EXPORT_WITH_DES_CBC_40_SHA", 0x0026, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_KRB5_EXPORT_WITH_RC2_CBC_40_SHA", 0x0027, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_KRB5_EXPORT_WITH_RC4_40_SHA", 0x0028, 40, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "TLS_KRB5_EXPORT_WITH_DES_CBC_40_MD5", 0x0029, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_KRB5_EXPORT_WITH_RC2_CBC_40_MD5", 0x002a, 40, SSLHAF_SUITE_EXPORT },
+    { "TLS_KRB5_EXPORT_WITH_RC4_40_MD5", 0x002b, 40, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "TLS_PSK_WITH_NULL_SHA", 0x002c, 0, SSLHAF_SUITE_NULL },
+    { "TLS_DHE_PSK_WITH_NULL_SHA", 0x002d, 0, SSLHAF_SUITE_NULL },
+    { "TLS_RSA_PSK_WITH_NULL_SHA", 0x002e, 0, SSLHAF_SUITE_NULL },
+    { "TLS_RSA_WITH_AES_128_CBC_SHA", 0x002f, 128, 0 },
+    { "TLS_DH_DSS_WITH_AES_128_CBC_SHA", 0x0030, 128, 0 },
+    { "TLS_DH_RSA_WITH_AES_128_CBC_SHA", 0x0031, 128, 0 },
+    { "TLS_DHE_DSS_WITH_AES_128_CBC_SHA", 0x0032, 128, 0 },
+    { "TLS_DHE_RSA_WITH_AES_128_CBC_SHA", 0x0033, 128, 0 },
+    { "TLS_DH_anon_WITH_AES_128_CBC_SHA", 0x0034, 128, SSLHAF_SUITE_ANON },
+    { "TLS_RSA_WITH_AES_256_CBC_SHA", 0x0035, 256, 0 },
+    { "TLS_DH_DSS_WITH_AES_256_CBC_SHA", 0x0036, 256, 0 },
+    { "TLS_DH_RSA_WITH_AES_256_CBC_SHA", 0x0037, 256, 0 },
+    { "TLS_DHE_DSS_WITH_AES_256_CBC_SHA", 0x0038, 256, 0 },
+    { "TLS_DHE_RSA_WITH_AES_256_CBC_SHA", 0x0039, 256, 0 },
+    { "TLS_DH_anon_WITH_AES_256_CBC_SHA", 0x003a, 256, SSLHAF_SUITE_ANON },
+    { "TLS_RSA_WITH_NULL_SHA256", 0x003b, 0, SSLHAF_SUITE_NULL },
+    { "TLS_RSA_WITH_AES_128_CBC_SHA256", 0x003c, 128, 0 },
+    { "TLS_RSA_WITH_AES_256_CBC_SHA256", 0x003d, 256, 0 },
+    { "TLS_DH_DSS_WITH_AES_128_CBC_SHA256", 0x003e, 128, 0 },
+    { "TLS_DH_RSA_WITH_AES_128_CBC_SHA256", 0x003f, 128, 0 },
+    { "TLS_DHE_DSS_WITH_AES_128_CBC_SHA256", 0x0040, 128, 0 },
+    { "TLS_RSA_WITH_CAMELLIA_128_CBC_SHA", 0x0041, 128, 0 },
+    { "TLS_DH_DSS_WITH_CAMELLIA_128_CBC_SHA", 0x0042, 128, 0 },
+    { "TLS_DH_RSA_WITH_CAMELLIA_128_CBC_SHA", 0x0043, 128, 0 },
+    { "TLS_DHE_DSS_WITH_CAMELLIA_128_CBC_SHA", 0x0044, 128, 0 },
+    { "TLS_DHE_RSA_WITH_CAMELLIA_128_CBC_SHA", 0x0045, 128, 0 },
+    { "TLS_DH_anon_WITH_CAMELLIA_128_CBC_SHA", 0x0046, 128, SSLHAF_SUITE_ANON },
+    { "TLS_RSA_EXPORT1024_WITH_RC4_56_MD5", 0x0060, 56, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "TLS_RSA_EXPORT1024_WITH_RC2_CBC_56_MD5", 0x0061, 56, SSLHAF_SUITE_EXPORT },
+    { "TLS_RSA_EXPORT1024_WITH_DES_CBC_SHA", 0x0062, 56, SSLHAF_SUITE_EXPORT },
+    { "TLS_DHE_DSS_EXPORT1024_WITH_DES_CBC_SHA", 0x0063, 56, SSLHAF_SUITE_EXPORT },
+    { "TLS_RSA_EXPORT1024_WITH_RC4_56_SHA", 0x0064, 56, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "TLS_DHE_DSS_EXPORT1024_WITH_RC4_56_SHA", 0x0065, 56, SSLHAF_SUITE_RC4|SSLHAF_SUITE_EXPORT },
+    { "TLS_DHE_DSS_WITH_RC4_128_SHA", 0x0066, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_DHE_RSA_WITH_AES_128_CBC_SHA256", 0x0067, 128, 0 },
+    { "TLS_DH_DSS_WITH_AES_256_CBC_SHA256", 0x0068, 256, 0 },
+    { "TLS_DH_RSA_WITH_AES_256_CBC_SHA256", 0x0069, 256, 0 },
+    { "TLS_DHE_DSS_WITH_AES_256_CBC_SHA256", 0x006a, 256, 0 },
+    { "TLS_DHE_RSA_WITH_AES_256_CBC_SHA256", 0x006b, 256, 0 },
+    { "TLS_DH_anon_WITH_AES_128_CBC_SHA256", 0x006c, 128, SSLHAF_SUITE_ANON },
+    { "TLS_DH_anon_WITH_AES_256_CBC_SHA256", 0x006d, 256, SSLHAF_SUITE_ANON },
+    { "TLS_RSA_WITH_CAMELLIA_256_CBC_SHA", 0x0084, 256, 0 },
+    { "TLS_DH_DSS_WITH_CAMELLIA_256_CBC_SHA", 0x0085, 256, 0 },
+    { "TLS_DH_RSA_WITH_CAMELLIA_256_CBC_SHA", 0x0086, 256, 0 },
+    { "TLS_DHE_DSS_WITH_CAMELLIA_256_CBC_SHA", 0x0087, 256, 0 },
+    { "TLS_DHE_RSA_WITH_CAMELLIA_256_CBC_SHA", 0x0088, 256, 0 },
+    { "TLS_DH_anon_WITH_CAMELLIA_256_CBC_SHA", 0x0089, 256, SSLHAF_SUITE_ANON },
+    { "TLS_PSK_WITH_RC4_128_SHA", 0x008a, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_PSK_WITH_3DES_EDE_CBC_SHA", 0x008b, 168, 0 },
+    { "TLS_PSK_WITH_AES_128_CBC_SHA", 0x008c, 128, 0 },
+    { "TLS_PSK_WITH_AES_256_CBC_SHA", 0x008d, 256, 0 },
+    { "TLS_DHE_PSK_WITH_RC4_128_SHA", 0x008e, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_DHE_PSK_WITH_3DES_EDE_CBC_SHA", 0x008f, 168, 0 },
+    { "TLS_DHE_PSK_WITH_AES_128_CBC_SHA", 0x0090, 128, 0 },
+    { "TLS_DHE_PSK_WITH_AES_256_CBC_SHA", 0x0091, 256, 0 },
+    { "TLS_RSA_PSK_WITH_RC4_128_SHA", 0x0092, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_RSA_PSK_WITH_3DES_EDE_CBC_SHA", 0x0093, 168, 0 },
+    { "TLS_RSA_PSK_WITH_AES_128_CBC_SHA", 0x0094, 128, 0 },
+    { "TLS_RSA_PSK_WITH_AES_256_CBC_SHA", 0x0095, 256, 0 },
+    { "TLS_RSA_WITH_SEED_CBC_SHA", 0x0096, 128, 0 },
+    { "TLS_DH_DSS_WITH_SEED_CBC_SHA", 0x0097, 128, 0 },
+    { "TLS_DH_RSA_WITH_SEED_CBC_SHA", 0x0098, 128, 0 },
+    { "TLS_DHE_DSS_WITH_SEED_CBC_SHA", 0x0099, 128, 0 },
+    { "TLS_DHE_RSA_WITH_SEED_CBC_SHA", 0x009a, 128, 0 },
+    { "TLS_DH_anon_WITH_SEED_CBC_SHA", 0x009b, 128, SSLHAF_SUITE_ANON },
+    { "TLS_RSA_WITH_AES_128_GCM_SHA256", 0x009c, 128, 0 },
+    { "TLS_RSA_WITH_AES_256_GCM_SHA384", 0x009d, 256, 0 },
+    { "TLS_DHE_RSA_WITH_AES_128_GCM_SHA256", 0x009e, 128, 0 },
+    { "TLS_DHE_RSA_WITH_AES_256_GCM_SHA384", 0x009f, 256, 0 },
+    { "TLS_DH_RSA_WITH_AES_128_GCM_SHA256", 0x00a0, 128, 0 },
+    { "TLS_DH_RSA_WITH_AES_256_GCM_SHA384", 0x00a1, 256, 0 },
+    { "TLS_DHE_DSS_WITH_AES_128_GCM_SHA256", 0x00a2, 128, 0 },
+    { "TLS_DHE_DSS_WITH_AES_256_GCM_SHA384", 0x00a3, 256, 0 },
+    { "TLS_DH_DSS_WITH_AES_128_GCM_SHA256", 0x00a4, 128, 0 },
+    { "TLS_DH_DSS_WITH_AES_256_GCM_SHA384", 0x00a5, 256, 0 },
+    { "TLS_DH_anon_WITH_AES_128_GCM_SHA256", 0x00a6, 128, SSLHAF_SUITE_ANON },
+    { "TLS_DH_anon_WITH_AES_256_GCM_SHA384", 0x00a7, 256, SSLHAF_SUITE_ANON },
+    { "TLS_EMPTY_RENEGOTIATION_INFO_SCSV", 0x00ff, 0, SSLHAF_SUITE_SCSV },
+    { "TLS_AES_128_GCM_SHA256", 0x1301, 128, 0 },
+    { "TLS_AES_256_GCM_SHA384", 0x1302, 256, 0 },
+    { "TLS_CHACHA20_POLY1305_SHA256", 0x1303, 256, 0 },
+    { "TLS_AES_128_CCM_SHA256", 0x1304, 128, 0 },
+    { "TLS_AES_128_CCM_8_SHA256", 0x1305, 128, 0 },
+    { "TLS_ECDH_ECDSA_WITH_NULL_SHA", 0xc001, 0, SSLHAF_SUITE_NULL },
+    { "TLS_ECDH_ECDSA_WITH_RC4_128_SHA", 0xc002, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_ECDH_ECDSA_WITH_3DES_EDE_CBC_SHA", 0xc003, 168, 0 },
+    { "TLS_ECDH_ECDSA_WITH_AES_128_CBC_SHA", 0xc004, 128, 0 },
+    { "TLS_ECDH_ECDSA_WITH_AES_256_CBC_SHA", 0xc005, 256, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_NULL_SHA", 0xc006, 0, SSLHAF_SUITE_NULL },
+    { "TLS_ECDHE_ECDSA_WITH_RC4_128_SHA", 0xc007, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_ECDHE_ECDSA_WITH_3DES_EDE_CBC_SHA", 0xc008, 168, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA", 0xc009, 128, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA", 0xc00a, 256, 0 },
+    { "TLS_ECDH_RSA_WITH_NULL_SHA", 0xc00b, 0, SSLHAF_SUITE_NULL },
+    { "TLS_ECDH_RSA_WITH_RC4_128_SHA", 0xc00c, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_ECDH_RSA_WITH_3DES_EDE_CBC_SHA", 0xc00d, 168, 0 },
+    { "TLS_ECDH_RSA_WITH_AES_128_CBC_SHA", 0xc00e, 128, 0 },
+    { "TLS_ECDH_RSA_WITH_AES_256_CBC_SHA", 0xc00f, 256, 0 },
+    { "TLS_ECDHE_RSA_WITH_NULL_SHA", 0xc010, 0, SSLHAF_SUITE_NULL },
+    { "TLS_ECDHE_RSA_WITH_RC4_128_SHA", 0xc011, 128, SSLHAF_SUITE_RC4 },
+    { "TLS_ECDHE_RSA_WITH_3DES_EDE_CBC_SHA", 0xc012, 168, 0 },
+    { "TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA", 0xc013, 128, 0 },
+    { "TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA", 0xc014, 256, 0 },
+    { "TLS_ECDH_anon_WITH_NULL_SHA", 0xc015, 0, SSLHAF_SUITE_NULL|SSLHAF_SUITE_ANON },
+    { "TLS_ECDH_anon_WITH_RC4_128_SHA", 0xc016, 128, SSLHAF_SUITE_RC4|SSLHAF_SUITE_ANON },
+    { "TLS_ECDH_anon_WITH_3DES_EDE_CBC_SHA", 0xc017, 168, SSLHAF_SUITE_ANON },
+    { "TLS_ECDH_anon_WITH_AES_128_CBC_SHA", 0xc018, 128, SSLHAF_SUITE_ANON },
+    { "TLS_ECDH_anon_WITH_AES_256_CBC_SHA", 0xc019, 256, SSLHAF_SUITE_ANON },
+    { "TLS_SRP_SHA_WITH_3DES_EDE_CBC_SHA", 0xc01a, 168, 0 },
+    { "TLS_SRP_SHA_RSA_WITH_3DES_EDE_CBC_SHA", 0xc01b, 168, 0 },
+    { "TLS_SRP_SHA_DSS_WITH_3DES_EDE_CBC_SHA", 0xc01c, 168, 0 },
+    { "TLS_SRP_SHA_WITH_AES_128_CBC_SHA", 0xc01d, 128, 0 },
+    { "TLS_SRP_SHA_RSA_WITH_AES_128_CBC_SHA", 0xc01e, 128, 0 },
+    { "TLS_SRP_SHA_DSS_WITH_AES_128_CBC_SHA", 0xc01f, 128, 0 },
+    { "TLS_SRP_SHA_WITH_AES_256_CBC_SHA", 0xc020, 256, 0 },
+    { "TLS_SRP_SHA_RSA_WITH_AES_256_CBC_SHA", 0xc021, 256, 0 },
+    { "TLS_SRP_SHA_DSS_WITH_AES_256_CBC_SHA", 0xc022, 256, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256", 0xc023, 128, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_AES_256_CBC_SHA384", 0xc024, 256, 0 },
+    { "TLS_ECDH_ECDSA_WITH_AES_128_CBC_SHA256", 0xc025, 128, 0 },
+    { "TLS_ECDH_ECDSA_WITH_AES_256_CBC_SHA384", 0xc026, 256, 0 },
+    { "TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256", 0xc027, 128, 0 },
+    { "TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA384", 0xc028, 256, 0 },
+    { "TLS_ECDH_RSA_WITH_AES_128_CBC_SHA256", 0xc029, 128, 0 },
+    { "TLS_ECDH_RSA_WITH_AES_256_CBC_SHA384", 0xc02a, 256, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256", 0xc02b, 128, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384", 0xc02c, 256, 0 },
+    { "TLS_ECDH_ECDSA_WITH_AES_128_GCM_SHA256", 0xc02d, 128, 0 },
+    { "TLS_ECDH_ECDSA_WITH_AES_256_GCM_SHA384", 0xc02e, 256, 0 },
+    { "TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256", 0xc02f, 128, 0 },
+    { "TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384", 0xc030, 256, 0 },
+    { "TLS_ECDH_RSA_WITH_AES_128_GCM_SHA256", 0xc031, 128, 0 },
+    { "TLS_ECDH_RSA_WITH_AES_256_GCM_SHA384", 0xc032, 256, 0 },
+    { "TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256", 0xcca8, 256, 0 },
+    { "TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256", 0xcca9, 256, 0 },
+    { "TLS_DHE_RSA_WITH_CHACHA20_POLY1305_SHA256", 0xccaa, 256, 0 },
+    { "SSL_RSA_FIPS_WITH_DES_CBC_SHA", 0xfefe, 56, 0 },
+    { "SSL_RSA_FIPS_WITH_3DES_EDE_CBC_SHA", 0xfeff, 168, 0 },
+    { "SSL_RSA_FIPS_WITH_3DES_EDE_CBC_SHA", 0xffe0, 168, 0 },
+    { "SSL_RSA_FIPS_WITH_DES_CBC_SHA", 0xffe1, 56, 0 },
+};
+
+static const unsigned char suite_pages[256] = {
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5, 6,
+};
+
+static const unsigned short suite_index[6][256] = {
+    /* 0x0000 */
+    {
+        9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+        25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+        41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56,
+        57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72,
+        73, 74, 75, 76, 77, 78, 79, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105,
+        106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121,
+        122, 123, 124, 125, 126, 127, 128, 129, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 130,
+    },
+    /* 0x1300 */
+    {
+        0, 131, 132, 133, 134, 135, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0xc000 */
+    {
+        0, 136, 137, 138, 139, 140, 141, 142, 143, 144, 145, 146, 147, 148, 149, 150,
+        151, 152, 153, 154, 155, 156, 157, 158, 159, 160, 161, 162, 163, 164, 165, 166,
+        167, 168, 169, 170, 171, 172, 173, 174, 175, 176, 177, 178, 179, 180, 181, 182,
+        183, 184, 185, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0xcc00 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 186, 187, 188, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0xfe00 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 189, 190,
+    },
+    /* 0xff00 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        191, 192, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+};
+
+static const char * const extension_table[] = {
+    "server_name",
+    "max_fragment_length",
+    "client_certificate_url",
+    "trusted_ca_keys",
+    "truncated_hmac",
+    "status_request",
+    "user_mapping",
+    "client_authz",
+    "server_authz",
+    "cert_type",
+    "elliptic_curves",
+    "ec_point_formats",
+    "srp",
+    "signature_algorithms",
+    "use_srtp",
+    "heartbeat",
+    "application_layer_protocol_negotiation",
+    "status_request_v2",
+    "signed_certificate_timestamp",
+    "padding",
+    "encrypt_then_mac",
+    "extended_master_secret",
+    "compress_certificate",
+    "record_size_limit",
+    "session_ticket",
+    "pre_shared_key",
+    "early_data",
+    "supported_versions",
+    "cookie",
+    "psk_key_exchange_modes",
+    "post_handshake_auth",
+    "signature_algorithms_cert",
+    "key_share",
+    "next_protocol_negotiation",
+    "application_settings",
+    "channel_id",
+    "encrypted_client_hello",
+    "renegotiation_info",
+};
+
+static const unsigned char extension_pages[256] = {
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 5, 6,
+};
+
+static const unsigned char extension_index[6][256] = {
+    /* 0x0000 */
+    {
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+        17, 18, 19, 0, 0, 20, 21, 22, 0, 0, 0, 23, 24, 0, 0, 0,
+        0, 0, 0, 25, 0, 0, 0, 0, 0, 26, 27, 28, 29, 30, 0, 0,
+        0, 31, 32, 33, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0x3300 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 34, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0x4400 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 35, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0x7500 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 36,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0xfe00 */
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 37, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+    /* 0xff00 */
+    {
+        0, 38, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    },
+};
+
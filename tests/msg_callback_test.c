@@ -0,0 +1,241 @@
+/*
+
+mod_sslhaf: Apache module for passive SSL client fingerprinting
+
+ | THIS PRODUCT IS NOT READY FOR PRODUCTION USE. DEPLOY AT YOUR OWN RISK.
+
+Copyright (c) 2009-2014, Qualys, Inc.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+* Redistributions of source code must retain the above copyright
+  notice, this list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright
+  notice, this list of conditions and the following disclaimer in the
+  documentation and/or other materials provided with the distribution.
+
+* Neither the name of the Qualys, Inc. nor the names of its
+  contributors may be used to endorse or promote products derived from
+  this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+/*
+ * msg_callback_test checks that the two backends of the module see the
+ * same ClientHello. For each ClientHello of the corpus (bench/corpus.txt),
+ * it fingerprints the bytes as the client sent them, 16 at a time, the
+ * way the input filter does, and then the way the OpenSSL message
+ * callback does: the handshake message on its own, with the records
+ * taken off, behind the header sslhaf_message_header() makes for it.
+ * Everything but the raw packet must come out the same.
+ *
+ * To compile and run, from the top directory:
+ *
+ *     $ cc -I. -o msg_callback_test tests/msg_callback_test.c sslhaf.c
+ *     $ ./msg_callback_test [bench/corpus.txt]
+ *
+ * The exit status is 1 if any ClientHello doesn't match.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sslhaf.h"
+
+#define TEST_ARENA_SIZE     (1024 * 1024)
+#define TEST_CHUNK          16
+
+/**
+ * Fingerprint len bytes, fed in chunks of the given size.
+ */
+static int feed(sslhaf_t *h, sslhaf_arena_t *arena, const unsigned char *data,
+    size_t len, size_t chunk)
+{
+    size_t off, n;
+    int rc = SSLHAF_AGAIN;
+
+    arena->used = 0;
+    sslhaf_init(h, SSLHAF_OUTPUT_ALL, SSLHAF_HELLO_LIMIT, sslhaf_arena_alloc, arena);
+
+    for (off = 0; (off < len)&&(rc == SSLHAF_AGAIN); off += n) {
+        n = ((chunk > 0)&&(len - off > chunk)) ? chunk : len - off;
+        rc = sslhaf_feed(h, data + off, n);
+    }
+
+    return rc;
+}
+
+/**
+ * Take the records off a ClientHello, leaving the handshake message,
+ * as OpenSSL hands it to the message callback. Returns the length of
+ * the message, or 0 if the records don't add up.
+ */
+static size_t strip_records(const unsigned char *data, size_t len, unsigned char *msg) {
+    size_t off = 0, msg_len = 0;
+
+    // SSLv2: one record, with a 2-byte header
+    if (data[0] & 0x80) {
+        memcpy(msg, data + 2, len - 2);
+        return len - 2;
+    }
+
+    while (off + 5 <= len) {
+        size_t record_len = (data[off + 3] * 256) + data[off + 4];
+
+        if (off + 5 + record_len > len) {
+            return 0;
+        }
+
+        memcpy(msg + msg_len, data + off + 5, record_len);
+        msg_len += record_len;
+        off += 5 + record_len;
+    }
+
+    return (off == len) ? msg_len : 0;
+}
+
+static int same(const char *a, const char *b) {
+    if ((a == NULL)||(b == NULL)) {
+        return a == b;
+    }
+
+    return strcmp(a, b) == 0;
+}
+
+/**
+ * Check one ClientHello. Returns -1 if the backends don't agree.
+ */
+static int check(const char *name, const unsigned char *data, size_t len,
+    sslhaf_arena_t *filter_arena, sslhaf_arena_t *msg_arena)
+{
+    static unsigned char buf[SSLHAF_HELLO_LIMIT + 1024];
+    sslhaf_t filter, msg;
+    size_t msg_len, header_len;
+    int rc;
+
+    rc = feed(&filter, filter_arena, data, len, TEST_CHUNK);
+    if ((rc != SSLHAF_DONE)||(!filter.done)) {
+        printf("FAIL %s: filter: %s\n", name, filter.error[0] != '\0' ? filter.error : "incomplete");
+        return -1;
+    }
+
+    // The header goes in front of the message, as the callback feeds them
+    msg_len = strip_records(data, len, buf + 5);
+    header_len = sslhaf_message_header((data[0] & 0x80) ? 2 : 3, data + 1, msg_len, buf);
+    if ((msg_len == 0)||(header_len == 0)) {
+        printf("FAIL %s: can't be handed over as a message\n", name);
+        return -1;
+    }
+
+    memmove(buf + header_len, buf + 5, msg_len);
+
+    rc = feed(&msg, msg_arena, buf, header_len + msg_len, 0);
+    if ((rc != SSLHAF_DONE)||(!msg.done)) {
+        printf("FAIL %s: message: %s\n", name, msg.error[0] != '\0' ? msg.error : "incomplete");
+        return -1;
+    }
+
+    if ((filter.hello_version != msg.hello_version)
+        ||(filter.protocol_high != msg.protocol_high)
+        ||(filter.protocol_low != msg.protocol_low)
+        ||(!same(filter.tja3_suites, msg.tja3_suites))
+        ||(!same(filter.compression_methods, msg.compression_methods))
+        ||(!same(filter.tja3_extensions, msg.tja3_extensions))
+        ||(!same(filter.tja3_curves, msg.tja3_curves))
+        ||(!same(filter.tja3_ec_point, msg.tja3_ec_point))
+        ||(!same(filter.tflags, msg.tflags))
+        ||(!same(filter.tsuite_min_bits, msg.tsuite_min_bits))
+        ||(!same(filter.ja3_hash, msg.ja3_hash))
+        ||(!same(filter.ja4, msg.ja4)))
+    {
+        printf("FAIL %s: filter %s %s, message %s %s\n", name, filter.ja3_hash, filter.ja4,
+            msg.ja3_hash, msg.ja4);
+        return -1;
+    }
+
+    printf("ok   %s %s %s\n", name, filter.ja3_hash, filter.ja4);
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    static char line[(SSLHAF_HELLO_LIMIT + 1024) * 2];
+    static unsigned char data[SSLHAF_HELLO_LIMIT + 1024];
+    const char *filename = (argc > 1) ? argv[1] : "bench/corpus.txt";
+    sslhaf_arena_t filter_arena, msg_arena;
+    int checked = 0, failed = 0;
+    FILE *f;
+
+    filter_arena.base = malloc(TEST_ARENA_SIZE);
+    filter_arena.size = TEST_ARENA_SIZE;
+    msg_arena.base = malloc(TEST_ARENA_SIZE);
+    msg_arena.size = TEST_ARENA_SIZE;
+    if ((filter_arena.base == NULL)||(msg_arena.base == NULL)) {
+        fprintf(stderr, "msg_callback_test: Out of memory\n");
+        return 2;
+    }
+
+    f = fopen(filename, "r");
+    if (f == NULL) {
+        perror(filename);
+        return 2;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char *hex;
+        size_t len;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if ((line[0] == '\0')||(line[0] == '#')) {
+            continue;
+        }
+
+        // The name, the hex, and whatever else the line may have
+        hex = strchr(line, ' ');
+        if (hex == NULL) {
+            fprintf(stderr, "msg_callback_test: %s: Invalid entry\n", filename);
+            fclose(f);
+            return 2;
+        }
+
+        *hex++ = '\0';
+        len = strcspn(hex, " ");
+
+        if ((len % 2 != 0)||(len / 2 > sizeof(data))
+            ||(sslhaf_hex_decode(hex, len / 2, data) < 0))
+        {
+            fprintf(stderr, "msg_callback_test: %s: Invalid hex in %s\n", filename, line);
+            fclose(f);
+            return 2;
+        }
+
+        checked++;
+        if (check(line, data, len / 2, &filter_arena, &msg_arena) < 0) {
+            failed++;
+        }
+    }
+
+    fclose(f);
+
+    printf("%d ClientHellos, %d failed\n", checked, failed);
+
+    return (failed > 0) ? 1 : 0;
+}